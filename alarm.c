@@ -0,0 +1,212 @@
+// Title:    Alarms
+// File:     alarm.c
+//
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "date.h"
+#include "eemap.h"
+#include "persist.h"
+#include "sched.h"
+#include "alarm.h"
+
+#define DDR(x) (*(&x - 1))
+
+#define MINUTES_PER_DAY 1440UL
+
+// ring for this many ticks, beeping on and off every BEEP_TICKS
+#define RING_TICKS      (60 * SCHED_HZ)
+#define BEEP_TICKS      (SCHED_HZ / 2)
+
+volatile uint32_t alarm_now;
+volatile uint32_t alarm_next = ALARM_NEVER;
+volatile uint8_t alarm_pending;
+
+static struct alarm alarms[ALARM_COUNT];
+
+// alarms that are set, soonest first
+static struct {
+    uint32_t when;
+    uint8_t n;
+} table[ALARM_COUNT];
+static uint8_t table_size;
+
+static uint16_t ring_ticks;
+// alarms changed but not yet written to EEPROM, bit n for alarm n
+static uint16_t unsaved;
+
+#define ALARM_BIT(n) ((uint16_t)1 << (n))
+
+#define ALARM_ADDRESS(n) \
+    ((struct alarm *)(EEMAP_ALARMS + (n) * sizeof(struct alarm)))
+
+// The first time after now that alarm goes off, or ALARM_NEVER.
+static uint32_t next_time(const struct alarm *alarm, uint32_t now)
+{
+    uint16_t today = now / MINUTES_PER_DAY;
+    uint16_t minute = alarm->hour * 60 + alarm->minute;
+    uint32_t when;
+    uint8_t n;
+
+    switch (alarm->type) {
+    case ALARM_ONCE:
+        when = alarm->date * MINUTES_PER_DAY + minute;
+        return (when > now) ? when : ALARM_NEVER;
+    case ALARM_DAILY:
+        when = today * MINUTES_PER_DAY + minute;
+        return (when > now) ? when : when + MINUTES_PER_DAY;
+    case ALARM_WEEKDAYS:
+        for (n = 0; n < 8; n++) {
+            when = (today + n) * MINUTES_PER_DAY + minute;
+            if ((when > now) &&
+                    (alarm->weekdays & _BV(date_weekday(today + n))))
+                return when;
+        }
+        break;
+    }
+    return ALARM_NEVER;
+}
+
+// Put alarm n into the table in order.  The table must not hold it.
+static void table_insert(uint8_t n, uint32_t now)
+{
+    uint32_t when = next_time(&alarms[n], now);
+    uint8_t i;
+
+    if (when == ALARM_NEVER)
+        return;
+    for (i = table_size; i > 0 && table[i - 1].when > when; i--)
+        table[i] = table[i - 1];
+    table[i].when = when;
+    table[i].n = n;
+    table_size++;
+}
+
+static void table_remove(uint8_t n)
+{
+    uint8_t i, j;
+
+    for (i = j = 0; i < table_size; i++)
+        if (table[i].n != n)
+            table[j++] = table[i];
+    table_size = j;
+}
+
+static void table_publish(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        alarm_next = table_size ? table[0].when : ALARM_NEVER;
+        alarm_pending = 0;
+    }
+}
+
+static uint32_t now_stamp(void)
+{
+    uint32_t now;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now = alarm_now;
+    }
+    return now;
+}
+
+void alarm_init(void)
+{
+    uint32_t now = now_stamp();
+    uint8_t n;
+
+    DDR(BUZZER_PORT) |= _BV(BUZZER_PIN);
+    eeprom_read_block(alarms, (const void *)EEMAP_ALARMS, sizeof(alarms));
+    table_size = 0;
+    for (n = 0; n < ALARM_COUNT; n++) {
+        // erased EEPROM, or garbage
+        if (alarms[n].type > ALARM_WEEKDAYS || alarms[n].hour > 23 ||
+                alarms[n].minute > 59)
+            alarms[n].type = ALARM_OFF;
+        table_insert(n, now);
+    }
+    table_publish();
+}
+
+void alarm_get(uint8_t n, struct alarm *alarm)
+{
+    *alarm = alarms[n];
+}
+
+void alarm_set(uint8_t n, const struct alarm *alarm)
+{
+    alarms[n] = *alarm;
+    unsaved |= ALARM_BIT(n);
+    table_remove(n);
+    table_insert(n, now_stamp());
+    table_publish();
+}
+
+void alarm_ring(void)
+{
+    ring_ticks = RING_TICKS;
+}
+
+uint8_t alarm_armed(void)
+{
+    return table_size != 0;
+}
+
+uint8_t alarm_ringing(void)
+{
+    return ring_ticks != 0;
+}
+
+void alarm_silence(void)
+{
+    ring_ticks = 0;
+    BUZZER_PORT &= ~_BV(BUZZER_PIN);
+}
+
+// Write one changed alarm to EEPROM, unless the checkpoint writer owns
+// it just now.
+static void alarm_save(void)
+{
+    uint8_t n;
+
+    if (!unsaved || persist_busy())
+        return;
+    for (n = 0; !(unsaved & ALARM_BIT(n)); n++)
+        ;
+    unsaved &= ~ALARM_BIT(n);
+    eeprom_update_block(&alarms[n], ALARM_ADDRESS(n), sizeof(alarms[n]));
+}
+
+void alarm_poll(void)
+{
+    uint32_t now;
+    uint8_t n;
+
+    alarm_save();
+    if (alarm_pending) {
+        now = now_stamp();
+        // everything due goes off together and is put back in order
+        while (table_size && table[0].when <= now) {
+            n = table[0].n;
+            table_remove(n);
+            if (alarms[n].type == ALARM_ONCE) {
+                alarms[n].type = ALARM_OFF;
+                unsaved |= ALARM_BIT(n);
+            } else
+                table_insert(n, now);
+            alarm_ring();
+        }
+        table_publish();
+    }
+
+    if (ring_ticks) {
+        ring_ticks--;
+        if (ring_ticks % BEEP_TICKS == 0)
+            BUZZER_PORT ^= _BV(BUZZER_PIN);
+        if (!ring_ticks)
+            BUZZER_PORT &= ~_BV(BUZZER_PIN);
+    }
+}
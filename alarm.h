@@ -0,0 +1,94 @@
+// Title:    Alarms
+// File:     alarm.h
+//
+// Up to ALARM_COUNT alarms are kept in EEPROM.  The time each enabled
+// alarm fires next is worked out as a minute stamp, minutes since
+// 1 January 2020 on the wall clock, and the alarms are kept sorted by
+// it.  The clock keeps the current minute stamp in alarm_now, so the
+// check every second is one compare against the earliest alarm, and
+// the table is only worked out again when an alarm fires, an alarm is
+// changed or the clock is set.
+//
+// Working from wall clock minutes handles daylight saving: an alarm in
+// the hour skipped in spring goes off when the clock jumps past it, one
+// in the hour repeated in autumn goes off the first time only, because
+// by the second time round its next time is already the next day.
+//
+
+#ifndef ALARM_H
+#define ALARM_H
+
+#include <inttypes.h>
+
+#define ALARM_COUNT     16
+
+// alarm types
+#define ALARM_OFF       0
+#define ALARM_ONCE      1       // on date only
+#define ALARM_DAILY     2
+#define ALARM_WEEKDAYS  3       // on the days set in weekdays
+
+// weekday bits, bit 0 is Sunday as in date_weekday()
+#define ALARM_MON_FRI   0x3E
+#define ALARM_SAT_SUN   0x41
+
+#ifndef BUZZER_PORT
+#define BUZZER_PORT     PORTB
+#endif
+#ifndef BUZZER_PIN
+#define BUZZER_PIN      PB4
+#endif
+
+struct alarm {
+    uint8_t type;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t weekdays;
+    uint16_t date;          // date_days() of the date for ALARM_ONCE
+};
+
+#define ALARM_NEVER     0xFFFFFFFF
+
+// Current wall clock minute stamp, kept up to date by the clock.
+extern volatile uint32_t alarm_now;
+// Minute stamp of the earliest alarm, ALARM_NEVER if none is set.
+extern volatile uint32_t alarm_next;
+// Set when an alarm is due, cleared by alarm_poll().
+extern volatile uint8_t alarm_pending;
+
+// Called from the timer interrupt once a second.
+static inline void alarm_check(void)
+{
+    if (alarm_now >= alarm_next)
+        alarm_pending = 1;
+}
+
+// Load the alarms from EEPROM and work out when they go off.  Also to
+// be called after the clock was set.
+void alarm_init(void);
+
+// Fire due alarms, drive the buzzer and save changed alarms.  Call
+// every tick.
+void alarm_poll(void);
+
+// Non-zero if any alarm is set.
+uint8_t alarm_armed(void);
+
+// Non-zero while the buzzer is sounding.
+uint8_t alarm_ringing(void);
+
+// Stop the buzzer.
+void alarm_silence(void);
+
+// Copy alarm n.
+void alarm_get(uint8_t n, struct alarm *alarm);
+
+// Change alarm n and reschedule.  alarm_poll() saves it to EEPROM once
+// no checkpoint is being written.
+void alarm_set(uint8_t n, const struct alarm *alarm);
+
+// Sound the buzzer as if an alarm went off, e.g. at the end of a
+// countdown.
+void alarm_ring(void);
+
+#endif // ALARM_H
@@ -4,23 +4,94 @@
 //
 
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include <util/atomic.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include <avr/wdt.h>
 #include "lcd.h"
-#include "clock.h"
 #include "debounce.h"
+#include "persist.h"
+#include "powerfail.h"
+#include "date.h"
+#include "clocksource.h"
+#include "i2c.h"
+#include "rtc.h"
+#include "sched.h"
+#include "alarm.h"
+#include "stopwatch.h"
+#include "reset.h"
+#include "diag.h"
+#include "telemetry.h"
+#include "tz.h"
+#include "layout.h"
+#include "marquee.h"
+#include "power.h"
+#include "sun.h"
+#include "clock.h"
 
 //avrfreaks.net thread suggestions
 //https://www.avrfreaks.net/forum/avr-project-build-clock-program-atmega162?page=1
 // 
 #define TICS_PER_SECOND 200
+#if F_CPU % TICS_PER_SECOND
+#error "F_CPU must be a whole number of cycles per tick"
+#endif
 #define DEBOUNCE_TIME 1000
+// minutes between EEPROM checkpoints of the clock state
+#define CHECKPOINT_MINUTES 15
+// minute of each hour at which the clock re-synchronises to the RTC
+#define SYNC_MINUTE 30
+// ticks between screen updates, and while a stopwatch is shown
+#define RENDER_TICKS 20
+#define RENDER_TICKS_FAST 10
+// ticks between steps of the marquee
+#define MARQUEE_TICKS 40
+// ticks a stopwatch lap time is shown for
+#define LAP_SHOW_TICKS 400
+// set_time steps through these with button 0:
+//   0 - 5   set year, month, day, hour, minute, second
+//   6 - 8   clock, big clock, blank
+//   9 - 11  set alarm hour, minute, days
+//   12 - 13 stopwatch, countdown
+//   14      world clock
+//   15      marquee, on a 16x2 LCD
+//   16      sunrise, sunset and the moon, 15 on other LCDs
+#define MODE_MARQUEE 15
+#define MODE_SUN (MODE_MARQUEE + MARQUEE)
+#define MODES (MODE_SUN + 1)
+// Not in the cycle: button 2 on the blank screen shows the diagnostics,
+// button 1 there turns the page, button 2 forgets the longest interrupt,
+// or on a task's page its longest run, and button 0 goes on to setting
+// the alarm.
+#define MODE_DIAG MODES
+// pages before those of the tasks
+#define DIAG_PAGES 5
+// Watchdog period, longer than the slowest task: an alarm_poll() that
+// writes a changed alarm's EEPROM bytes.
+#define WATCHDOG WDTO_500MS
+// Ticks lost to a reset: the time-out of the 4MHz crystal fuse setting,
+// 16K CK plus 65ms, and main() up to enabling interrupts.
+#define RESET_LOST_TICKS 14
+// Try to initialize a display that stopped answering this often.
+#define LCD_RETRY_SECONDS 10
+
+// LCD writes a screen update may make, the rest waits for the next
+#define LAYOUT_WRITES 12
+// Ticks each frame of a tall digit changing is shown, 25 a second, and
+// how many may change at once
+#define WIPE_TICKS 8
+#define WIPES 4
 
-static const PROGMEM uint8_t extended_character_table[]  =
+// Glyphs for the LCD glyph cache, which keeps the ones on the screen
+// in the 8 CGRAM characters.
+#define GLYPH_BELL 8
+#define GLYPH_WIPE 9    // three, see wipe_cells
+#define GLYPHS 12
+static const PROGMEM uint8_t glyph_table[GLYPHS * 8] =
 {
     0x07, 0x0F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F,
     0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -29,31 +100,411 @@ static const PROGMEM uint8_t extended_character_table[]  =
     0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F,
     0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1E, 0x1C,
     0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00, 0x1F, 0x1F,
-    0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F
+    0x1F, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F,
+    0x04, 0x0E, 0x0E, 0x0E, 0x1F, 0x00, 0x04, 0x00,     // bell
+    0x00, 0x00, 0x00, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F,
+    0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x1F, 0x1F, 0x1F,
+    0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x00, 0x00, 0x00,
+};
+
+// Big digits, two lines of four characters.  Values below GLYPHS are
+// glyphs from the table above, the rest LCD ROM characters.
+static const PROGMEM uint8_t big_font[10][8] =
+{
+    {   0,   1,   2,  20,     3,   4,   5,  20 },     // 0
+    {   1,   2,  20,  20,    20, 255,  20,  20 },     // 1
+    {   6,   6,   2,  20,     3,   7,   7,  20 },     // 2
+    {   6,   6,   2,  20,     7,   7,   5,  20 },     // 3
+    {   3,   4,   2,  20,    20,  20, 255,  20 },     // 4
+    { 255,   6,   6,  20,     7,   7,   5,  20 },     // 5
+    {   0,   6,   6,  20,     3,   7,   5,  20 },     // 6
+    {   1,   1,   2,  20,    20,   0,  20,  20 },     // 7
+    {   0,   6,   2,  20,     3,   7,   5,  20 },     // 8
+    {   0,   6,   2,  20,    20,  20, 255,  20 },     // 9
 };
+// Screens, see layout.h.  Fields are drawn by lcd_display_field() as
+// format says, showing source.  FORMAT_CHAR repeats the character that
+// is its source over its width.
+#define FORMAT_CHAR         0
+#define FORMAT_TEXT         1   // layout_texts entry
+#define FORMAT_NUMBER       2   // right aligned
+#define FORMAT_TWO          3   // two digits
+#define FORMAT_WEEKDAY      4
+#define FORMAT_MONTH        5
+#define FORMAT_DAYS         6   // alarm days
+#define FORMAT_BELL         7   // bell glyph if an alarm is armed
+#define FORMAT_BIG_TENS     8   // big digits, two lines, width columns
+#define FORMAT_BIG_ONES     9
+#define FORMAT_COLON        10  // blinking, on two lines
+#define FORMAT_TALL_TENS    11  // four line digits, see tall_font
+#define FORMAT_TALL_ONES    12
+#define FORMAT_SMALL_TENS   13  // two line digits to go with them
+#define FORMAT_SMALL_ONES   14
+
+#define SOURCE_YEAR         0
+#define SOURCE_MONTH        1
+#define SOURCE_DAY          2
+#define SOURCE_WEEKDAY      3
+#define SOURCE_HOUR         4
+#define SOURCE_MINUTE       5
+#define SOURCE_SECOND       6
+#define SOURCE_ALARM_HOUR   7
+#define SOURCE_ALARM_MINUTE 8
+#define SOURCE_ALARM_DAYS   9
+
+#define DATE        LAYOUT_DATE | LAYOUT_ENTRY
+#define HOUR        LAYOUT_HOUR | LAYOUT_ENTRY
+#define MINUTE      LAYOUT_MINUTE | LAYOUT_ENTRY
+#define SECOND      LAYOUT_SECOND | LAYOUT_ENTRY
+#define BLINK       LAYOUT_BLINK | LAYOUT_ENTRY
+#define ALARM       LAYOUT_ALARM | LAYOUT_ENTRY
+#define EDIT        LAYOUT_EDIT | LAYOUT_ENTRY
+#define ENTRY       LAYOUT_ENTRY
+
+static const char layout_texts[] PROGMEM = "Alarm 1";
+
+#if TALL_FONT
+
+// Digits four lines high for the big clock, and two lines high for its
+// seconds, three columns each.  They only take the upper and lower bar
+// and the two bars glyphs and the ROM full block, leaving CGRAM room.
+#define U 1
+#define L 4
+#define B 6
+#define F 255
+#define _ ' '
+#define X GLYPH_WIPE
+#define Y (GLYPH_WIPE + 1)
+#define Z (GLYPH_WIPE + 2)
+static const PROGMEM uint8_t tall_font[10][12] =
+{
+    { F, U, F,   F, _, F,   F, _, F,   F, L, F },   // 0
+    { U, F, _,   _, F, _,   _, F, _,   L, F, L },   // 1
+    { U, U, F,   L, L, F,   F, _, _,   F, L, L },   // 2
+    { U, U, F,   _, L, F,   _, _, F,   L, L, F },   // 3
+    { F, _, F,   F, L, F,   _, _, F,   _, _, F },   // 4
+    { F, U, U,   F, L, L,   _, _, F,   L, L, F },   // 5
+    { F, U, U,   F, L, L,   F, _, F,   F, L, F },   // 6
+    { U, U, F,   _, _, F,   _, _, F,   _, _, F },   // 7
+    { F, U, F,   F, L, F,   F, _, F,   F, L, F },   // 8
+    { F, U, F,   F, L, F,   _, _, F,   L, L, F },   // 9
+};
+static const PROGMEM uint8_t small_font[10][6] =
+{
+    { F, U, F,   F, L, F },     // 0
+    { _, _, F,   _, _, F },     // 1
+    { B, B, F,   F, L, L },     // 2
+    { B, B, F,   L, L, F },     // 3
+    { F, L, F,   _, _, F },     // 4
+    { F, B, B,   L, L, F },     // 5
+    { F, B, B,   F, L, F },     // 6
+    { U, U, F,   _, _, F },     // 7
+    { F, B, F,   F, L, F },     // 8
+    { F, B, F,   L, L, F },     // 9
+};
+
+// A tall digit changes by wiping the new one down over the old, a line
+// at a time.  The tall font cells are made of three bands of rows,
+// upper bar (0 - 2), middle (3 - 4) and lower bar (5 - 7), so the line
+// being wiped only needs to show the new digit's upper band, and then
+// its upper and middle bands, over the old one.  That takes only the
+// three wipe glyphs.  Indexed by those two steps, then by the old
+// cell and the new cell, blank, U, L or F.
+static const PROGMEM uint8_t wipe_cells[2][16] =
+{
+    { _, U, _, U,   _, U, _, U,   L, Y, L, Y,   X, F, X, F },
+    { _, U, _, Z,   _, U, _, Z,   L, Y, L, F,   L, Y, L, F },
+};
+#undef U
+#undef L
+#undef B
+#undef F
+#undef _
+#undef X
+#undef Y
+#undef Z
+
+//   Wed Jan  1, 2020
 //
-// Add hour minute second
+//       12:00:00
+//                     B
+static const PROGMEM struct layout_field clock_screen[] = {
+    {  2, 0, 3, FORMAT_WEEKDAY, SOURCE_WEEKDAY, DATE },
+    {  6, 0, 3, FORMAT_MONTH,   SOURCE_MONTH,   DATE },
+    { 10, 0, 2, FORMAT_NUMBER,  SOURCE_DAY,     DATE },
+    { 12, 0, 1, FORMAT_CHAR,    ',',            ENTRY },
+    { 14, 0, 4, FORMAT_NUMBER,  SOURCE_YEAR,    DATE },
+    {  6, 2, 2, FORMAT_TWO,     SOURCE_HOUR,    HOUR },
+    {  8, 2, 1, FORMAT_CHAR,    ':',            ENTRY },
+    {  9, 2, 2, FORMAT_TWO,     SOURCE_MINUTE,  MINUTE },
+    { 11, 2, 1, FORMAT_CHAR,    ':',            ENTRY },
+    { 12, 2, 2, FORMAT_TWO,     SOURCE_SECOND,  SECOND },
+    { 19, 3, 1, FORMAT_BELL,    0,              ALARM },
+};
+
+// the setting screens show the fields set so far, set_fields of them
+static const PROGMEM struct layout_field set_screen[] = {
+    { 14, 0, 4, FORMAT_NUMBER,  SOURCE_YEAR,    DATE },
+    {  6, 0, 3, FORMAT_MONTH,   SOURCE_MONTH,   DATE },
+    { 10, 0, 2, FORMAT_NUMBER,  SOURCE_DAY,     DATE },
+    { 12, 0, 1, FORMAT_CHAR,    ',',            ENTRY },
+    {  6, 2, 2, FORMAT_TWO,     SOURCE_HOUR,    HOUR },
+    {  8, 2, 1, FORMAT_CHAR,    ':',            ENTRY },
+    {  9, 2, 2, FORMAT_TWO,     SOURCE_MINUTE,  MINUTE },
+    { 11, 2, 1, FORMAT_CHAR,    ':',            ENTRY },
+    { 12, 2, 2, FORMAT_TWO,     SOURCE_SECOND,  SECOND },
+};
+
+// HHHHHH MMMMMM Wed  B    four line hours and minutes, two line
+// HHHHHH:MMMMMM            seconds.  The seconds come first, so they
+// HHHHHH:MMMMMM SSSSSS     are drawn first when the writes a pass may
+// HHHHHH MMMMMM SSSSSS     make run out.
+static const PROGMEM struct layout_field big_screen[] = {
+    { 17, 2, 3, FORMAT_SMALL_ONES, SOURCE_SECOND,  SECOND },
+    { 14, 2, 3, FORMAT_SMALL_TENS, SOURCE_SECOND,  SECOND },
+    {  6, 1, 1, FORMAT_COLON,      0,              BLINK },
+    { 10, 0, 3, FORMAT_TALL_ONES,  SOURCE_MINUTE,  MINUTE },
+    {  7, 0, 3, FORMAT_TALL_TENS,  SOURCE_MINUTE,  MINUTE },
+    {  3, 0, 3, FORMAT_TALL_ONES,  SOURCE_HOUR,    HOUR },
+    {  0, 0, 3, FORMAT_TALL_TENS,  SOURCE_HOUR,    HOUR },
+    {  6, 0, 1, FORMAT_CHAR,       ' ',            ENTRY },
+    {  6, 3, 1, FORMAT_CHAR,       ' ',            ENTRY },
+    { 13, 0, 1, FORMAT_CHAR,       ' ',            ENTRY },
+    { 14, 0, 3, FORMAT_WEEKDAY,    SOURCE_WEEKDAY, DATE },
+    { 17, 0, 2, FORMAT_CHAR,       ' ',            ENTRY },
+    { 19, 0, 1, FORMAT_BELL,       0,              ALARM },
+    { 13, 1, 7, FORMAT_CHAR,       ' ',            ENTRY },
+    { 13, 2, 1, FORMAT_CHAR,       ' ',            ENTRY },
+    { 13, 3, 1, FORMAT_CHAR,       ' ',            ENTRY },
+};
+
+// Alarm 1
 //
-volatile uint16_t year = 2020;
-volatile uint8_t month = 1;
-volatile uint8_t hour = 0;
-volatile uint8_t minute = 0;
-volatile uint8_t day = 1;
-volatile uint8_t second = 0;
-volatile uint8_t lastdom;
-volatile uint8_t daylight_time = 1;
+//     07:30  Mon-Fri
+static const PROGMEM struct layout_field alarm_screen[] = {
+    {  0, 0, 7, FORMAT_TEXT,    0,                   ENTRY },
+    {  4, 2, 2, FORMAT_TWO,     SOURCE_ALARM_HOUR,   EDIT },
+    {  6, 2, 1, FORMAT_CHAR,    ':',                 ENTRY },
+    {  7, 2, 2, FORMAT_TWO,     SOURCE_ALARM_MINUTE, EDIT },
+    { 11, 2, 7, FORMAT_DAYS,    SOURCE_ALARM_DAYS,   EDIT },
+};
+
+#else
+
+// Wed Jan  1, 2020
+//     12:00:00   B
+static const PROGMEM struct layout_field clock_screen[] = {
+    {  0, 0, 3, FORMAT_WEEKDAY, SOURCE_WEEKDAY, DATE },
+    {  3, 0, 1, FORMAT_CHAR,    ' ',            ENTRY },
+    {  4, 0, 3, FORMAT_MONTH,   SOURCE_MONTH,   DATE },
+    {  7, 0, 1, FORMAT_CHAR,    ' ',            ENTRY },
+    {  8, 0, 2, FORMAT_NUMBER,  SOURCE_DAY,     DATE },
+    { 10, 0, 1, FORMAT_CHAR,    ',',            ENTRY },
+    { 11, 0, 1, FORMAT_CHAR,    ' ',            ENTRY },
+    { 12, 0, 4, FORMAT_NUMBER,  SOURCE_YEAR,    DATE },
+    {  0, 1, 4, FORMAT_CHAR,    ' ',            ENTRY },
+    {  4, 1, 2, FORMAT_TWO,     SOURCE_HOUR,    HOUR },
+    {  6, 1, 1, FORMAT_CHAR,    ':',            ENTRY },
+    {  7, 1, 2, FORMAT_TWO,     SOURCE_MINUTE,  MINUTE },
+    {  9, 1, 1, FORMAT_CHAR,    ':',            ENTRY },
+    { 10, 1, 2, FORMAT_TWO,     SOURCE_SECOND,  SECOND },
+    { 12, 1, 3, FORMAT_CHAR,    ' ',            ENTRY },
+    { 15, 1, 1, FORMAT_BELL,    0,              ALARM },
+};
+
+// the setting screens show the fields set so far, set_fields of them
+static const PROGMEM struct layout_field set_screen[] = {
+    { 12, 0, 4, FORMAT_NUMBER,  SOURCE_YEAR,    DATE },
+    {  4, 0, 3, FORMAT_MONTH,   SOURCE_MONTH,   DATE },
+    {  8, 0, 2, FORMAT_NUMBER,  SOURCE_DAY,     DATE },
+    { 10, 0, 1, FORMAT_CHAR,    ',',            ENTRY },
+    {  4, 1, 2, FORMAT_TWO,     SOURCE_HOUR,    HOUR },
+    {  6, 1, 1, FORMAT_CHAR,    ':',            ENTRY },
+    {  7, 1, 2, FORMAT_TWO,     SOURCE_MINUTE,  MINUTE },
+    {  9, 1, 1, FORMAT_CHAR,    ':',            ENTRY },
+    { 10, 1, 2, FORMAT_TWO,     SOURCE_SECOND,  SECOND },
+};
+
+// HH HH MM MM, big digits four columns wide
+static const PROGMEM struct layout_field big_screen[] = {
+    {  0, 0, 4, FORMAT_BIG_TENS, SOURCE_HOUR,   HOUR },
+    {  4, 0, 4, FORMAT_BIG_ONES, SOURCE_HOUR,   HOUR },
+    {  8, 0, 4, FORMAT_BIG_TENS, SOURCE_MINUTE, MINUTE },
+    { 12, 0, 4, FORMAT_BIG_ONES, SOURCE_MINUTE, MINUTE },
+};
+
+// Alarm 1
+//   07:30  Mon-Fri
+static const PROGMEM struct layout_field alarm_screen[] = {
+    {  0, 0, 7, FORMAT_TEXT,    0,                   ENTRY },
+    {  2, 1, 2, FORMAT_TWO,     SOURCE_ALARM_HOUR,   EDIT },
+    {  4, 1, 1, FORMAT_CHAR,    ':',                 ENTRY },
+    {  5, 1, 2, FORMAT_TWO,     SOURCE_ALARM_MINUTE, EDIT },
+    {  9, 1, 7, FORMAT_DAYS,    SOURCE_ALARM_DAYS,   EDIT },
+};
+
+#endif
+
+static const PROGMEM uint8_t set_fields[6] = { 1, 2, 4, 5, 7, 9 };
+
+#undef DATE
+#undef HOUR
+#undef MINUTE
+#undef SECOND
+#undef BLINK
+#undef ALARM
+#undef EDIT
+#undef ENTRY
+// The time, local wall time.  dst_active tells the two times of the
+// hour repeated when daylight saving ends apart.
+struct clock_state {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t dst_active;
+};
+volatile struct clock_state now = { 2020, 1, 1, 0, 0, 0, 0 };
 volatile uint8_t set_time = 6;
+uint8_t screen_mode = 0xFF;
+// the time as the screen shows it, and what changed since, see layout.h
+struct clock_state shown;
+uint8_t shown_alarm;
+uint8_t shown_blink;
+uint8_t layout_dirty;
+#if TALL_FONT
+// digits on the screen by their column, 0xFF if not known, and the
+// writes left in this update
+uint8_t cell_digits[LCD_DISP_LENGTH];
+uint8_t layout_writes;
+// Tall digits changing, x is 0xFF for none.  The frame drawn counts
+// from the old digit, 0, to the new one, WIPE_FRAMES; see wipe_cell().
+#define WIPE_FRAMES 9
+struct wipe {
+    uint8_t x;
+    uint8_t from;
+    uint8_t to;
+    uint8_t frame;
+    uint16_t start;         // sched_ticks when it started
+};
+struct wipe wipes[WIPES] = { { 0xFF }, { 0xFF }, { 0xFF }, { 0xFF } };
+uint8_t wiping;
+#endif
+// minute stamp of midnight today, see alarm.h
+volatile uint32_t day_stamp;
+struct alarm alarm_edit;
+// big digits on the screen, 0xFF for none, and the character between
+// the second and third digit
+uint8_t big_digits[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+uint8_t big_separator = 0xFF;
+uint16_t lap_shown;
+#if DIAG_ENABLE
+uint8_t diag_page;
+#endif
 volatile uint8_t nsubticks = TICS_PER_SECOND;
-volatile uint8_t i;
+// The time, kept over a watchdog or software reset.  Written by the
+// interrupt every second, check is 0x5A plus the sum of the other
+// bytes.  kept_subticks is nsubticks, written every tick.
+struct clock_kept {
+    struct clock_state time;
+    uint8_t set_time;
+    uint8_t check;
+};
+struct clock_kept kept __attribute__((section(".noinit")));
+volatile uint8_t kept_subticks __attribute__((section(".noinit")));
+uint8_t checkpoint_minute = 0xFF;
+// set by the interrupt when it changes the hour for daylight saving
+volatile uint8_t time_jumped;
+// the zone the clock keeps, and the minute stamp of its next change
+struct tz_zone local_zone;
+volatile uint32_t dst_change = TZ_NEVER;
+// the other zones in EEPROM for the world clock, and the minute stamp
+// it was last drawn for
+struct tz_zone world_zones[TZ_ZONES - 1];
+uint8_t world_count;
+uint32_t world_minute;
+// the day sunrise was last started and drawn for
+uint16_t sun_day = SUN_NONE;
+uint16_t sun_shown;
+// how long the power was off before this boot, when it is known
+uint32_t power_off_seconds;
+uint8_t lastgasp_restored;
+struct task debounce_task = TASK(debounce_run, 1);
+struct task input_task = TASK(input_run, 1);
+struct task render_task = TASK(render_run, RENDER_TICKS);
+struct task housekeeping_task = TASK(housekeeping_run, TICS_PER_SECOND);
+struct task alarm_task = TASK(alarm_poll, 1);
+struct task stopwatch_task = TASK(stopwatch_poll, 1);
+#if TALL_FONT
+struct task wipe_task = TASK(wipe_run, WIPE_TICKS);
+#endif
+struct task sun_task = TASK(sun_run, 1);
+#if RTC_ENABLE
+struct task sync_task = TASK(clock_sync_poll, 1);
+#endif
+#if DIAG_ENABLE && SCHED_STATS
+// the tasks with a diagnostics page each, and their names there
+static const struct {
+    struct task *task;
+    uint8_t name;
+} diag_tasks[] = {
+    { &debounce_task, 9 },
+    { &input_task, 10 },
+    { &render_task, 11 },
+    { &housekeeping_task, 12 },
+    { &alarm_task, 13 },
+    { &stopwatch_task, 14 },
+#if TALL_FONT
+    { &wipe_task, 15 },
+#endif
+    { &sun_task, 16 },
+#if RTC_ENABLE
+    { &sync_task, 17 },
+#endif
+};
+#define DIAG_TASKS (sizeof(diag_tasks) / sizeof(diag_tasks[0]))
+#else
+#define DIAG_TASKS 0
+#endif
+#if RTC_ENABLE
+uint8_t sync_minute = 0xFF;
+uint8_t sync_ticks;
+uint8_t sync_second;
+uint8_t sync_subtick;
+// ticks the clock was ahead of the RTC at the last sync
+int8_t sync_drift;
+#endif
 
 
-const char *weekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
-const char *months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul",
-    "Aug", "Sep", "Oct", "Nov", "Dec" };
-const char daytab[2][12] = {
-    {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31},
-    {31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}
-};  
+// Names for the display, a NUL after each
+static const char weekday_names[] PROGMEM =
+    "Sun\0" "Mon\0" "Tue\0" "Wed\0" "Thu\0" "Fri\0" "Sat";
+static const char month_names[] PROGMEM =
+    "Jan\0" "Feb\0" "Mar\0" "Apr\0" "May\0" "Jun\0"
+    "Jul\0" "Aug\0" "Sep\0" "Oct\0" "Nov\0" "Dec";
+static const char alarm_day_names[] PROGMEM =
+    "Off    \0" "Once   \0" "Daily  \0" "Mon-Fri\0" "Sat-Sun";
+static const char moon_names[] PROGMEM =
+    "new   \0" "waxing\0" "full  \0" "waning";
+#if MARQUEE
+// in full for the marquee, ten characters each
+static const char weekday_long_names[] PROGMEM =
+    "Sunday\0\0\0\0" "Monday\0\0\0\0" "Tuesday\0\0\0" "Wednesday\0"
+    "Thursday\0\0" "Friday\0\0\0\0" "Saturday";
+static const char month_long_names[] PROGMEM =
+    "January\0\0\0" "February\0\0" "March\0\0\0\0\0" "April\0\0\0\0\0"
+    "May\0\0\0\0\0\0\0" "June\0\0\0\0\0\0" "July\0\0\0\0\0\0"
+    "August\0\0\0\0" "September\0" "October\0\0\0" "November\0\0"
+    "December";
+#endif
+#if DIAG_ENABLE
+static const char diag_names[] PROGMEM =
+    "ISR max\0ISR avg\0Loops/s\0LCD B/s\0Spins/s\0Stack  \0Up days\0"
+    "Fast/s \0    avg\0Deb max\0Inp max\0Rnd max\0Hsk max\0Alm max\0"
+    "Stw max\0Wip max\0Sun max\0Syn max\0";
+#endif
 
 //
 // Interrupt service routine
@@ -63,163 +514,423 @@ ISR(TIMER1_COMPA_vect);
 
 int main(void)
 {
+    uint8_t warm = 0;
+
+    power_init();
     buttons_init();
     timer_init();
     debounce_init();
+    clock_restore();
+#if RTC_ENABLE
+    i2c_init();
+    clock_source_boot();
+#endif
+    powerfail_init();
+    telemetry_init();
+    tz_load(0, &local_zone);
+    world_init();
+    clock_stamp();
+    alarm_init();
     // set global interrupts
     sei();
-    // initialize display, cursor off
-    lcd_init(LCD_DISP_ON);
-    lcd_clrscr();
-    lcd_command(_BV(LCD_CGRAM));
-    for(i=0; i<64; i++)
-    {
-        lcd_data(pgm_read_byte_near(&extended_character_table[i]));
+    // initialize display, cursor off.  A display that stayed powered
+    // through the reset is taken over as it is.
+    if (reset_power_on())
+        lcd_init(LCD_DISP_ON);
+    else
+        warm = lcd_init_warm(LCD_DISP_ON);
+    lcd_glyph_library(glyph_table, GLYPHS);
+    if (!warm) {
+        // The display can't show that it can't be read, sound the buzzer.
+        if (!lcd_probe())
+            alarm_ring();
+        lcd_clrscr();
     }
 
-    for (;;)
-    {
+    sched_add(&debounce_task, 1);
+    sched_add(&input_task, 1);
+    sched_add(&render_task, 1);
+    sched_add(&housekeeping_task, TICS_PER_SECOND);
+    sched_add(&alarm_task, 1);
+    sched_add(&stopwatch_task, 1);
+#if RTC_ENABLE
+    sched_add(&sync_task, 1);
+#endif
 
-        if (button_down(BUTTON0_MASK))
-            set_time++;
-
-        switch (set_time % 9) {
-        case 0:
-            set_year();
-            // if button press up
-            //  year++
-            //  if year == 2020
-            //      year = 0
-            if (button_down(BUTTON1_MASK)) {
-                year++;
-                if (year == 2120)
-                    year = 2020;
-            }
-            // if button press down
-            //      year--
-            //  if year == -1
-            //      year == 2020
-            if (button_down(BUTTON2_MASK)) {
-                year--;
-                if (year == -1)
-                    year = 2020;
-            }
-            break;
-        case 1:
-            set_month();
-            // if button press up
-            //  month++
-            //  if month == 13
-            //      month = 1
-            if (button_down(BUTTON1_MASK)) {
-                month++;
-                if (month == 13)
-                    month = 1;
-            }
-            // if button press down
-            //  month--
-            //  if month == 0
-            //      month = 12
-            if (button_down(BUTTON2_MASK)) {
-                month--;
-                if (month == 0)
-                    month = 12;
-            }
-            break;
-        case 2:
-            set_day();
-            // lastdom is not set until the month is set once
-            // so call it here in case someone wants to go
-            // backwards through the months, otherwise we get
-            // month = 255, 254, etc.
-            //
-            // if button press up
-            //  day++
-            //  if day > lastdom
-            //      day = 1
-            if (!leap_year(year))
-                lastdom = daytab[0][month - 1];
+    wdt_enable(WATCHDOG);
+    // set up at full speed, slow down from the next tick
+    power_burst_end();
+    for (;;) {
+        wdt_reset();
+        diag_loop();
+        sched_run();
+        power_idle();
+    }
+}
+
+static void debounce_run()
+{
+    debounce();
+}
+
+// Handle the buttons.  Button 0 steps through the setting screens and
+// the display modes, buttons 1 and 2 change the value being set.
+static void input_run()
+{
+    uint8_t lastdom;
+
+    // any button stops a ringing alarm and does nothing else
+    if (alarm_ringing()) {
+        if (button_down(BUTTON_MASK))
+            alarm_silence();
+        return;
+    }
+
+    if (button_down(BUTTON0_MASK)) {
+        set_time = (set_time == MODE_DIAG) ? 9 : (set_time + 1) % MODES;
+        // leaving the last setting screen, save what was entered
+        if (set_time == 6) {
+#if RTC_ENABLE
+            clock_source_write();
+#endif
+            clock_checkpoint();
+            clock_stamp();
+            alarm_init();
+        }
+        if (set_time == 9)
+            alarm_get(0, &alarm_edit);
+        if (set_time == 12)
+            alarm_set(0, &alarm_edit);
+    }
+
+    switch (set_time) {
+    case 0:
+        // if button press up
+        //  year++
+        //  if year > 2119
+        //      year = 2020
+        // the dates, alarms, time zones and sun are only good for
+        // 2020 to 2119
+        if (button_down(BUTTON1_MASK)) {
+            now.year++;
+            if ((now.year < 2020) || (now.year > 2119))
+                now.year = 2020;
+        }
+        // if button press down
+        //  year--
+        //  if year < 2020
+        //      year = 2119
+        if (button_down(BUTTON2_MASK)) {
+            now.year--;
+            if ((now.year < 2020) || (now.year > 2119))
+                now.year = 2119;
+        }
+        break;
+    case 1:
+        // if button press up
+        //  month++
+        //  if month == 13
+        //      month = 1
+        if (button_down(BUTTON1_MASK)) {
+            now.month++;
+            if (now.month == 13)
+                now.month = 1;
+        }
+        // if button press down
+        //  month--
+        //  if month == 0
+        //      month = 12
+        if (button_down(BUTTON2_MASK)) {
+            now.month--;
+            if (now.month == 0)
+                now.month = 12;
+        }
+        break;
+    case 2:
+        // if button press up
+        //  day++
+        //  if day > lastdom
+        //      day = 1
+        lastdom = days_in_month(now.year, now.month);
+        if (button_down(BUTTON1_MASK)) {
+            now.day++;
+            if (now.day > lastdom)
+                now.day = 1;
+        }
+        // if button press down
+        //  day--
+        //  if day < 1
+        //      day = lastdom
+        if (button_down(BUTTON2_MASK)) {
+            now.day--;
+            if (now.day < 1)
+                now.day = lastdom;
+        }
+        break;
+    case 3:
+        // if button press up
+        //  hour++
+        //  if hour == 24
+        //      hour = 0
+        if (button_down(BUTTON1_MASK)) {
+            now.hour++;
+            if (now.hour > 23)
+                now.hour = 0;
+        }
+        // if button press down
+        //  hour--
+        //  if hour == 255
+        //      hour = 23
+        if (button_down(BUTTON2_MASK)) {
+            now.hour--;
+            if (now.hour == 255)
+                now.hour = 23;
+        }
+        break;
+    case 4:
+        // if button press up
+        //  minute++
+        //  if minute == 60
+        //      minute = 0
+        if (button_down(BUTTON1_MASK)) {
+            now.minute++;
+            if (now.minute == 60)
+                now.minute = 0;
+        }
+        // if button press down
+        //  minute--
+        //  if minute == 255
+        //      minute = 59
+        if (button_down(BUTTON2_MASK)) {
+            now.minute--;
+            if (now.minute == 255)
+                now.minute = 59;
+        }
+        break;
+    case 5:
+        // if button press up second = 0;
+        if (button_down(BUTTON1_MASK)) {
+            now.second = 0;
+        }
+        // if button press down second = 0;
+        if (button_down(BUTTON2_MASK)) {
+            now.second = 0;
+        }
+        break;
+#if DIAG_ENABLE
+    case 8:
+        if (button_down(BUTTON2_MASK))
+            set_time = MODE_DIAG;
+        break;
+    case MODE_DIAG:
+        if (button_down(BUTTON1_MASK)) {
+            diag_page = (diag_page + 1) % (DIAG_PAGES + DIAG_TASKS);
+            screen_mode = 0xFF;
+        }
+        if (button_down(BUTTON2_MASK)) {
+#if SCHED_STATS
+            if (diag_page >= DIAG_PAGES)
+                diag_tasks[diag_page - DIAG_PAGES].task->max_cycles = 0;
             else
-                lastdom = daytab[1][month - 1];
-            if (button_down(BUTTON1_MASK)) {
-                day++;
-                if (day > lastdom)
-                    day = 1;
-            }
-            // if button press down
-            //  day--
-            //  if day < 1
-            //      day = lastdom
-            if (button_down(BUTTON2_MASK)) {
-                day--;
-                if (day < 1)
-                    day = lastdom;
-            }
-            break;
-        case 3:
-            set_hour();
-            // if button press up
-            //  hour++
-            //  if hour == 24
-            //      hour = 0
-            if (button_down(BUTTON1_MASK)) {
-                hour++;
-                if (hour > 23)
-                    hour = 0;
-            }
-            // if button press down
-            //  hour--
-            //  if hour == 255
-            //      hour = 23
-            if (button_down(BUTTON2_MASK)) {
-                hour--;
-                if (hour == 255)
-                    hour = 23;
-            }
-            break;
-        case 4:
-            // if button press up
-            //  minute++
-            //  if minute == 60
-            //      minute = 0
-            set_minute();
-            if (button_down(BUTTON1_MASK)) {
-                minute++;
-                if (minute == 60)
-                    minute = 0;
-            }
-            // if button press down
-            //  minute--
-            //  if minute == 255
-            //      minute = 59
-            if (button_down(BUTTON2_MASK)) {
-                minute--;
-                if (minute == 255)
-                    minute = 59;
-            }
-            break;
-        case 5:
-            set_second();
-            // if button press up second = 0;
-            if (button_down(BUTTON1_MASK)) {
-                second = 0;
+#endif
+                diag_reset_max();
+        }
+        break;
+#endif
+    case 9:
+        if (button_down(BUTTON1_MASK)) {
+            alarm_edit.hour++;
+            if (alarm_edit.hour > 23)
+                alarm_edit.hour = 0;
+        }
+        if (button_down(BUTTON2_MASK)) {
+            alarm_edit.hour--;
+            if (alarm_edit.hour == 255)
+                alarm_edit.hour = 23;
+        }
+        break;
+    case 10:
+        if (button_down(BUTTON1_MASK)) {
+            alarm_edit.minute++;
+            if (alarm_edit.minute == 60)
+                alarm_edit.minute = 0;
+        }
+        if (button_down(BUTTON2_MASK)) {
+            alarm_edit.minute--;
+            if (alarm_edit.minute == 255)
+                alarm_edit.minute = 59;
+        }
+        break;
+    case 11:
+        // off, daily, Monday to Friday, weekends
+        if (button_down(BUTTON1_MASK | BUTTON2_MASK)) {
+            if (alarm_edit.type != ALARM_WEEKDAYS) {
+                alarm_edit.type = (alarm_edit.type == ALARM_DAILY) ?
+                    ALARM_WEEKDAYS : ALARM_DAILY;
+                alarm_edit.weekdays = ALARM_MON_FRI;
+            } else if (alarm_edit.weekdays == ALARM_MON_FRI) {
+                alarm_edit.weekdays = ALARM_SAT_SUN;
+            } else {
+                alarm_edit.type = ALARM_OFF;
             }
-            // if button press down second = 0;
-            if (button_down(BUTTON2_MASK)) {
-                second = 0;
+        }
+        break;
+    case 12:
+        // start/stop, and lap while running or reset while stopped
+        if (button_down(BUTTON1_MASK))
+            stopwatch_toggle();
+        if (button_down(BUTTON2_MASK)) {
+            if (stopwatch_running()) {
+                stopwatch_lap();
+                lap_shown = LAP_SHOW_TICKS;
+            } else {
+                stopwatch_reset();
             }
-            break;
-        case 6:
-            lcd_display_clock();
-            break;
-        case 7:
-            lcd_display_time_attribute_big(hour, minute);
-            break;
-        case 8:
+        }
+        break;
+    case 13:
+        // start/pause, and add a minute while paused
+        if (button_down(BUTTON1_MASK))
+            countdown_toggle();
+        if (button_down(BUTTON2_MASK))
+            countdown_add_minute();
+        break;
+    }
+}
+
+// Draw the screen for the current setting or display mode.
+static void render_run()
+{
+    // the LCD delays are timed for F_CPU
+    power_burst();
+    // the setting screens draw over what the one before left
+    if (set_time != screen_mode) {
+        screen_mode = set_time;
+        if ((set_time == 0) || (set_time == 9) || (set_time >= 12))
             lcd_clrscr();
-            break;
+        lcd_forget_big_digits();
+        lap_shown = 0;
+        world_minute = TZ_NEVER;
+        sun_shown = SUN_NONE;
+        layout_dirty = LAYOUT_ALL;
+#if TALL_FONT
+        memset(cell_digits, 0xFF, sizeof(cell_digits));
+        // stop the wipes, wipe_run() finds none left
+        memset(wipes, 0xFF, sizeof(wipes));
+#endif
+        render_task.period = ((set_time == 12) || (set_time == 13)) ?
+            RENDER_TICKS_FAST : RENDER_TICKS;
+#if MARQUEE
+        if (set_time == MODE_MARQUEE) {
+            marquee_start(0);
+            render_task.period = MARQUEE_TICKS;
         }
+#endif
     }
+
+    switch (set_time) {
+    case 0:
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+    case 5:
+        lcd_display_layout(set_screen,
+                pgm_read_byte(&set_fields[set_time]), 0);
+        break;
+    case 6:
+        lcd_display_layout(clock_screen, LAYOUT_FIELDS(clock_screen), 0);
+        break;
+    case 7:
+        lcd_display_layout(big_screen, LAYOUT_FIELDS(big_screen), 0);
+        break;
+    case 8:
+        lcd_clrscr();
+        break;
+    case 9:
+    case 10:
+    case 11:
+        lcd_display_layout(alarm_screen, LAYOUT_FIELDS(alarm_screen),
+                LAYOUT_EDIT);
+        break;
+    case 12:
+        if (lap_shown)
+            lcd_display_lap();
+        else
+            lcd_display_watch(stopwatch_ticks());
+        break;
+    case 13:
+        lcd_display_watch(countdown_ticks());
+        break;
+    case 14:
+        lcd_display_world();
+        break;
+#if MARQUEE
+    case MODE_MARQUEE:
+        lcd_display_marquee();
+        break;
+#endif
+    case MODE_SUN:
+        lcd_display_sun();
+        break;
+#if DIAG_ENABLE
+    case MODE_DIAG:
+        lcd_display_diag();
+        break;
+#endif
+    }
+    power_burst_end();
+}
+
+// Once a second: checkpoints, power fail and RTC upkeep.
+static void housekeeping_run()
+{
+    uint16_t today, year;
+
+    powerfail_poll();
+    diag_second();
+#if TELEMETRY_ENABLE
+    clock_telemetry();
+#endif
+
+    if (lcd_fault && (now.second % LCD_RETRY_SECONDS == 0)) {
+        power_burst();
+        lcd_init(LCD_DISP_ON);
+        lcd_glyph_library(glyph_table, GLYPHS);
+        screen_mode = 0xFF;
+        power_burst_end();
+    }
+
+    if ((now.minute % CHECKPOINT_MINUTES == 0) &&
+            (now.minute != checkpoint_minute) && clock_checkpoint())
+        checkpoint_minute = now.minute;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        today = day_stamp / 1440;
+        year = now.year;
+    }
+    if (today != sun_day) {
+        sun_day = today;
+        sun_start(today, year, &local_zone);
+        sched_remove(&sun_task);
+        sched_add(&sun_task, 1);
+    }
+
+    if (time_jumped) {
+        time_jumped = 0;
+        clock_dst_schedule();
+#if RTC_ENABLE
+        clock_source_write();
+#endif
+    }
+
+#if RTC_ENABLE
+    if ((now.minute == SYNC_MINUTE) && (now.minute != sync_minute)) {
+        sync_minute = now.minute;
+        clock_sync_start();
+    }
+#endif
 }
 
 static void buttons_init()
@@ -234,13 +945,317 @@ static void timer_init()
     TCCR1B = (1 << CS10) | (1 << WGM12);
     // set output compare A match
     TIMSK = (1 << OCIE1A);
-    // output compare register 1
-    OCR1A = 20000 -1;
+    // output compare register 1, one tick of the CPU clock
+    OCR1A = F_CPU / TICS_PER_SECOND - 1;
     // timer counter 1
     TCNT1 = 45536;
 }
 
 
+// Restore the newest checkpoint from EEPROM, if there is one.  Called
+// before interrupts are enabled.
+static void clock_restore()
+{
+    struct persist_record record;
+    uint8_t found;
+    uint16_t age;
+
+    // The ring is scanned even when the kept time is used, as that is
+    // what tells persist.c which slot and sequence number come next.
+    found = persist_restore(&record);
+    if (!reset_power_on() && clock_kept_restore())
+        return;
+    if (!found)
+        return;
+    if ((record.year < 2020) || (record.year > 2119) ||
+            (record.month < 1) || (record.month > 12) ||
+            (record.day < 1) || (record.day > 31) ||
+            (record.hour > 23) || (record.minute > 59) ||
+            (record.second > 59))
+        return;
+    now.year = record.year;
+    now.month = record.month;
+    now.day = record.day;
+    now.hour = record.hour;
+    now.minute = record.minute;
+    now.second = record.second;
+    now.dst_active = record.dst_active;
+    if ((record.mode >= 6) && (record.mode <= 8))
+        set_time = record.mode;
+
+    // The supply failed after the checkpoint was taken and the time it
+    // failed at was saved, so carry on from there.  There is no time
+    // reference for how long the power stayed off.
+    age = persist_lastgasp_age();
+    lastgasp_restored = (age != 0);
+    persist_age = age;
+    while (age--)
+        clock_second();
+    checkpoint_minute = now.minute;
+}
+
+// Sum of the bytes of the kept time that check covers.
+static uint8_t clock_kept_sum()
+{
+    const uint8_t *p = (const uint8_t *)&kept;
+    uint8_t n, sum = 0x5A;
+
+    for (n = 0; n < sizeof(kept) - 1; n++)
+        sum += p[n];
+    return sum;
+}
+
+// Keep the time for after a reset.  Called from the interrupt every
+// second.
+static inline void clock_keep(void)
+{
+    kept.time = now;
+    kept.set_time = set_time;
+    kept.check = clock_kept_sum();
+}
+
+// Carry on with the time kept over a reset, adding the ticks the reset
+// took.  Returns zero if nothing valid was kept, after a power-on reset
+// or a reset in the middle of clock_keep().
+static uint8_t clock_kept_restore()
+{
+    uint8_t lost = RESET_LOST_TICKS;
+
+    if ((kept.check != clock_kept_sum()) || (kept.time.month < 1) ||
+            (kept.time.month > 12) || (kept.time.day < 1) ||
+            (kept.time.day > 31) || (kept.time.hour > 23) ||
+            (kept.time.minute > 59) || (kept.time.second > 59) ||
+            (kept.set_time > MODE_DIAG) || (kept_subticks < 1) ||
+            (kept_subticks > TICS_PER_SECOND))
+        return 0;
+    now = kept.time;
+    set_time = kept.set_time;
+    nsubticks = kept_subticks;
+    while (lost >= nsubticks) {
+        lost -= nsubticks;
+        nsubticks = TICS_PER_SECOND;
+        clock_second();
+    }
+    nsubticks -= lost;
+    checkpoint_minute = now.minute;
+    return 1;
+}
+
+// Snapshot the clock and start writing it to EEPROM.  Returns zero if
+// the previous checkpoint is still being written.
+static uint8_t clock_checkpoint()
+{
+    struct persist_record record;
+
+    if (persist_busy())
+        return 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        record.year = now.year;
+        record.month = now.month;
+        record.day = now.day;
+        record.hour = now.hour;
+        record.minute = now.minute;
+        record.second = now.second;
+        record.dst_active = now.dst_active;
+        persist_age = 0;
+    }
+    record.mode = set_time;
+    return persist_save(&record);
+}
+
+#if RTC_ENABLE || TELEMETRY_ENABLE
+static void clock_get(struct clock_time *time)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        time->year = now.year;
+        time->month = now.month;
+        time->day = now.day;
+        time->hour = now.hour;
+        time->minute = now.minute;
+        time->second = now.second;
+    }
+}
+
+// seconds since 1 January 2020
+static uint32_t clock_seconds(const struct clock_time *time)
+{
+    return date_days(time->year, time->month, time->day) * 86400UL +
+        time->hour * 3600UL + time->minute * 60 + time->second;
+}
+#endif
+
+#if TELEMETRY_ENABLE
+// Queue this second's telemetry frame, see telemetry.h.
+static void clock_telemetry()
+{
+    static uint8_t sequence;
+    struct clock_time time;
+    struct telemetry frame;
+
+    frame.version = TELEMETRY_VERSION;
+    frame.sequence = sequence++;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        clock_get(&time);
+        frame.subticks = nsubticks;
+    }
+    frame.seconds = clock_seconds(&time);
+#if RTC_ENABLE
+    frame.drift = sync_drift;
+#else
+    frame.drift = 0;
+#endif
+    frame.reset_flags = reset_flags;
+    frame.presses[0] = button_presses[0];
+    frame.presses[1] = button_presses[1];
+    frame.presses[2] = button_presses[2];
+#if DIAG_ENABLE
+    frame.isr_max = diag.isr_max;
+    frame.isr_avg = diag.isr_avg;
+    frame.loops = diag.loops;
+    frame.lcd_bytes = diag.lcd_bytes;
+    frame.lcd_spins = diag.lcd_spins;
+    frame.stack_used = diag.stack_used;
+#else
+    frame.isr_max = frame.isr_avg = frame.loops = 0;
+    frame.lcd_bytes = frame.lcd_spins = frame.stack_used = 0;
+#endif
+    telemetry_send(&frame, sizeof(frame));
+}
+#endif
+
+#if RTC_ENABLE
+// Set the clock, starting the new second now.  Call with interrupts
+// disabled.
+static void clock_set(const struct clock_time *time)
+{
+    now.year = time->year;
+    now.month = time->month;
+    now.day = time->day;
+    now.hour = time->hour;
+    now.minute = time->minute;
+    now.second = time->second;
+    nsubticks = TICS_PER_SECOND;
+}
+
+// Read the RTC at full speed; i2c.c's bit delays are timed for F_CPU,
+// and at the slow clock a read would take longer than a tick.
+static uint8_t clock_source_read(struct clock_time *time)
+{
+    uint8_t ok;
+
+    power_burst();
+    ok = rtc_clock_source.read(time);
+    power_burst_end();
+    return ok;
+}
+
+// Take the time from the RTC at power up.  Where in its second the RTC
+// is, is not known until the next second starts, so assume the middle
+// and line the ticks up with clock_sync_start().
+static void clock_source_boot()
+{
+    struct clock_time rtc, then;
+
+    if (!clock_source_read(&rtc))
+        return;
+    if (lastgasp_restored) {
+        clock_get(&then);
+        power_off_seconds = clock_seconds(&rtc) - clock_seconds(&then);
+    }
+    clock_set(&rtc);
+    nsubticks = TICS_PER_SECOND / 2;
+    clock_sync_start();
+}
+
+// Write the time to the RTC after it was set or changed for daylight
+// saving.  The RTC restarts its second when written, so ours does too.
+static void clock_source_write()
+{
+    struct clock_time time;
+
+    // at full speed before the second restarts, so the write follows it
+    // closely
+    power_burst();
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        clock_get(&time);
+        nsubticks = TICS_PER_SECOND;
+    }
+    rtc_clock_source.write(&time);
+    power_burst_end();
+}
+
+// Start watching the RTC for the beginning of its next second.
+static void clock_sync_start()
+{
+    struct clock_time rtc;
+
+    if (!clock_source_read(&rtc))
+        return;
+    sync_second = rtc.second;
+    sync_subtick = nsubticks;
+    sync_ticks = TICS_PER_SECOND + 2;
+}
+
+// Once per tick while a sync is running, read the RTC.  When its
+// seconds change a new second has just begun, so the clock is set to
+// the RTC time with a full second to run, which lines up the ticks to
+// within one tick.  Between syncs the timer interrupt keeps the time.
+static void clock_sync_poll()
+{
+    struct clock_time rtc, then;
+    int32_t drift;
+
+    if (!sync_ticks || (sync_subtick == nsubticks))
+        return;
+    sync_subtick = nsubticks;
+    sync_ticks--;
+    if (!clock_source_read(&rtc)) {
+        sync_ticks = 0;
+        return;
+    }
+    if (rtc.second == sync_second)
+        return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        clock_get(&then);
+        drift = (int32_t)(clock_seconds(&then) - clock_seconds(&rtc)) *
+            TICS_PER_SECOND + TICS_PER_SECOND - nsubticks;
+        clock_set(&rtc);
+    }
+    sync_drift = (drift > 127) ? 127 : (drift < -127) ? -127 : drift;
+    sync_ticks = 0;
+}
+#endif
+
+// Work out the minute stamp of midnight and of now after the date or
+// time was changed other than by the clock ticking.
+static void clock_stamp()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        day_stamp = date_days(now.year, now.month, now.day) * 1440UL;
+        alarm_now = day_stamp + now.hour * 60 + now.minute;
+    }
+    clock_dst_schedule();
+}
+
+// Find out whether daylight saving is on and when it next changes,
+// after the time was set or the interrupt made a change.
+static void clock_dst_schedule()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now.dst_active = tz_dst(&local_zone, now.year, alarm_now,
+                now.dst_active);
+        dst_change = tz_next(&local_zone, now.year, alarm_now,
+                now.dst_active);
+    }
+}
+
 static void lcd_display_time_attribute(uint8_t attribute,
         uint8_t position, uint8_t line)
 {
@@ -254,458 +1269,793 @@ static void lcd_display_time_attribute(uint8_t attribute,
 
 static void lcd_display_time_attribute_big(uint8_t hour, uint8_t minute)
 {
-    switch (hour/10) {
-        case 0:
-            display_0(0);
-            break;
-        case 1:
-            display_1(0); 
-            break;
-        case 2:
-            display_2(0);
-            break;
+    lcd_display_big_digit(hour/10, 0);
+    lcd_display_big_digit(hour%10, 1);
+    lcd_display_big_digit(minute/10, 2);
+    lcd_display_big_digit(minute%10, 3);
+}
+
+// Show a stopwatch time in big digits, as seconds and hundredths for
+// the first minute and as minutes and seconds after that.
+static void lcd_display_watch(uint32_t ticks)
+{
+    uint32_t seconds = ticks / TICS_PER_SECOND;
+
+    if (seconds < 60) {
+        lcd_display_time_attribute_big(seconds,
+                (ticks % TICS_PER_SECOND) * 100 / TICS_PER_SECOND);
+        lcd_display_big_separator(' ', '.');
+    } else {
+        lcd_display_time_attribute_big((seconds / 60) % 100, seconds % 60);
+        lcd_display_big_separator(0xA5, 0xA5);
     }
+}
 
-    switch (hour%10) {
-        case 0:
-            display_0(4);
-            break;
-        case 1:
-            display_1(4); 
-            break;
-        case 2:
-            display_2(4);
-            break;
-        case 3:
-            display_3(4);
-            break;
-        case 4:
-            display_4(4); 
-            break;
-        case 5:
-            display_5(4);
-            break;
-        case 6:
-            display_6(4); 
-            break;
-        case 7:
-            display_7(4);
-            break;
-        case 8:
-            display_8(4);
-            break;
-        case 9:
-            display_9(4); 
-            break;
+// Show the last lap time for a while in place of the stopwatch.
+static void lcd_display_lap()
+{
+    uint32_t ticks = stopwatch_lap_ticks(0);
+    uint32_t seconds = ticks / TICS_PER_SECOND;
+    char buffer[3];
+
+    if (lap_shown == LAP_SHOW_TICKS) {
+        lcd_clrscr();
+        lcd_forget_big_digits();
+        lcd_puts_P("Lap ");
+        itoa(stopwatch_lap_count(), buffer, 10);
+        lcd_puts(buffer);
+        lcd_display_time_attribute((seconds / 60) % 100, 4, 1);
+        lcd_putc(':');
+        lcd_display_time_attribute(seconds % 60, 7, 1);
+        lcd_putc('.');
+        lcd_display_time_attribute((ticks % TICS_PER_SECOND) * 100 /
+                TICS_PER_SECOND, 10, 1);
+    }
+    if (lap_shown > RENDER_TICKS_FAST)
+        lap_shown -= RENDER_TICKS_FAST;
+    else {
+        lap_shown = 0;
+        lcd_clrscr();
     }
+}
 
-    switch (minute/10) {
-        case 0:
-            display_0(8);
-            break;
-        case 1:
-            display_1(8); 
-            break;
-        case 2:
-            display_2(8);
-            break;
-        case 3:
-            display_3(8);
-            break;
-        case 4:
-            display_4(8); 
-            break;
-        case 5:
-            display_5(8);
-            break;
+// Draw the characters between the second and third big digit, unless
+// they are there already.
+static void lcd_display_big_separator(uint8_t top, uint8_t bottom)
+{
+    if (big_separator == top)
+        return;
+    big_separator = top;
+    lcd_gotoxy(7, 0);
+    lcd_putc(top);
+    lcd_gotoxy(7, 1);
+    lcd_putc(bottom);
+}
+
+// Draw a big digit in place n (0 - 3) of the screen, unless it is
+// there already.  Each place is four columns wide, the digit and a
+// space.
+static void lcd_display_big_digit(uint8_t digit, uint8_t n)
+{
+    if (big_digits[n] == digit)
+        return;
+    big_digits[n] = digit;
+    // the separator shares a column with the second digit
+    if (n == 1)
+        big_separator = 0xFF;
+    lcd_display_big_glyphs(digit, n * 4, 0, 4);
+}
+
+// Draw the first width columns of a big digit at x on lines y, y + 1.
+static void lcd_display_big_glyphs(uint8_t digit, uint8_t x, uint8_t y,
+        uint8_t width)
+{
+    const uint8_t *cells = big_font[digit];
+    uint8_t n;
+
+    lcd_gotoxy(x, y);
+    for (n = 0; n < width; n++)
+        lcd_display_big_cell(pgm_read_byte(&cells[n]));
+    lcd_gotoxy(x, y + 1);
+    for (n = 0; n < width; n++)
+        lcd_display_big_cell(pgm_read_byte(&cells[n + 4]));
+}
+
+static void lcd_display_big_cell(uint8_t c)
+{
+    if (c < GLYPHS)
+        lcd_putglyph(c);
+    else
+        lcd_putc(c);
+}
+
+// Forget what big digits are on the screen, after it was cleared or
+// written over.
+static void lcd_forget_big_digits()
+{
+    uint8_t n;
+
+    for (n = 0; n < 4; n++)
+        big_digits[n] = 0xFF;
+    big_separator = 0xFF;
+}
+
+#if DIAG_ENABLE
+// One of the diagnostics: a name and a number at the right of line y.
+static void lcd_display_diag_value(uint8_t name, uint32_t value, uint8_t y)
+{
+    char buffer[11];
+    uint8_t length;
+
+    lcd_gotoxy(0, y);
+    lcd_puts_p(diag_name(name));
+    ultoa(value, buffer, 10);
+    length = strlen(buffer);
+    lcd_gotoxy(LCD_DISP_LENGTH - length, y);
+    lcd_puts(buffer);
+}
+
+// A page of the diagnostics, two numbers, the ticks at full speed or
+// the uptime.  Interrupt times are in crystal cycles, the rest per
+// second except the stack, the most bytes it has taken since reset.
+// Then a page for each task, its longest and average run in crystal
+// cycles.
+static void lcd_display_diag()
+{
+    uint32_t seconds = diag.uptime;
+#if SCHED_STATS
+    struct task *task;
+#endif
+
+    switch (diag_page) {
+    case 0:
+        lcd_display_diag_value(0, diag.isr_max, 0);
+        lcd_display_diag_value(1, diag.isr_avg, 1);
+        break;
+    case 1:
+        lcd_display_diag_value(2, diag.loops, 0);
+        lcd_display_diag_value(3, diag.lcd_bytes, 1);
+        break;
+    case 2:
+        lcd_display_diag_value(4, diag.lcd_spins, 0);
+        lcd_display_diag_value(5, diag.stack_used, 1);
+        break;
+    case 3:
+        lcd_display_diag_value(7, diag.fast_ticks, 0);
+        break;
+    case 4:
+        // days, then hh:mm:ss
+        lcd_display_diag_value(6, seconds / 86400, 0);
+        seconds %= 86400;
+        lcd_display_time_attribute(seconds / 3600, 8, 1);
+        lcd_putc(':');
+        lcd_display_time_attribute((seconds / 60) % 60, 11, 1);
+        lcd_putc(':');
+        lcd_display_time_attribute(seconds % 60, 14, 1);
+        break;
+#if SCHED_STATS
+    default:
+        task = diag_tasks[diag_page - DIAG_PAGES].task;
+        lcd_display_diag_value(diag_tasks[diag_page - DIAG_PAGES].name,
+                task->max_cycles, 0);
+        lcd_display_diag_value(8, task->runs ?
+                task->total_cycles / task->runs : 0, 1);
+        break;
+#endif
     }
+}
 
-    switch (minute%10) {
-        case 0:
-            display_0(12);
-            break;
-        case 1:
-            display_1(12); 
-            break;
-        case 2:
-            display_2(12);
-            break;
-        case 3:
-            display_3(12);
-            break;
-        case 4:
-            display_4(12); 
-            break;
-        case 5:
-            display_5(12);
-            break;
-        case 6:
-            display_6(12); 
-            break;
-        case 7:
-            display_7(12);
-            break;
-        case 8:
-            display_8(12);
-            break;
-        case 9:
-            display_9(12); 
-            break;
+#endif
+
+// Draw the fields of a screen that changed since it was last drawn,
+// and those that depend on extra.
+static void lcd_display_layout(const struct layout_field *table,
+        uint8_t count, uint8_t extra)
+{
+    struct clock_state time;
+    uint8_t dirty = layout_dirty | extra;
+    uint8_t armed = alarm_armed() != 0;
+    uint8_t blink;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        time = now;
+        // on from a quarter to three quarters of the second, so it
+        // does not change with the digits
+        blink = (nsubticks > TICS_PER_SECOND / 4) &&
+            (nsubticks <= TICS_PER_SECOND * 3 / 4);
     }
+    if (time.second != shown.second)
+        dirty |= LAYOUT_SECOND;
+    if (time.minute != shown.minute)
+        dirty |= LAYOUT_MINUTE;
+    if (time.hour != shown.hour)
+        dirty |= LAYOUT_HOUR;
+    if ((time.day != shown.day) || (time.month != shown.month) ||
+            (time.year != shown.year))
+        dirty |= LAYOUT_DATE;
+    if (armed != shown_alarm)
+        dirty |= LAYOUT_ALARM;
+    if (blink != shown_blink)
+        dirty |= LAYOUT_BLINK;
+    shown = time;
+    shown_alarm = armed;
+    shown_blink = blink;
+    layout_dirty = 0;
+#if TALL_FONT
+    layout_writes = LAYOUT_WRITES;
+#endif
+    layout_render(table, count, dirty, lcd_display_field);
 }
 
-static void set_year()
+#if TALL_FONT
+// Draw digit from font, lines of three columns, at x, y.  Only the
+// cells that differ from the digit there are written, a run a line.
+// Returns zero without drawing if that takes more writes than are left
+// for this update.  A digit that needs more than a whole update is
+// drawn when it comes first, and it's all drawn when the screen was
+// not known.
+static uint8_t lcd_display_cells(const uint8_t *font, uint8_t lines,
+        uint8_t digit, uint8_t x, uint8_t y)
 {
-    if (day < 10)
-        lcd_gotoxy(11,0);
-    else
-        lcd_gotoxy(12,0);
-    lcd_display_year();
+    uint8_t old = cell_digits[x];
+    const uint8_t *was = font + old * lines * 3;
+    const uint8_t *cells = font + digit * lines * 3;
+    uint8_t first[4], last[4];
+    uint8_t writes = 0;
+    uint8_t line, n;
+
+    if (old == digit)
+        return 1;
+    for (line = 0; line < lines; line++) {
+        first[line] = 3;
+        last[line] = 0;
+        for (n = 0; n < 3; n++) {
+            if ((old != 0xFF) && (pgm_read_byte(&was[line * 3 + n]) ==
+                        pgm_read_byte(&cells[line * 3 + n])))
+                continue;
+            if (first[line] == 3)
+                first[line] = n;
+            last[line] = n;
+        }
+        if (first[line] < 3)
+            writes += 2 + last[line] - first[line];
+    }
+    if (old != 0xFF) {
+        if ((writes > layout_writes) && (layout_writes < LAYOUT_WRITES))
+            return 0;
+        layout_writes -= (writes > layout_writes) ? layout_writes : writes;
+    }
+
+    for (line = 0; line < lines; line++) {
+        if (first[line] == 3)
+            continue;
+        lcd_gotoxy(x + first[line], y + line);
+        for (n = first[line]; n <= last[line]; n++)
+            lcd_display_big_cell(pgm_read_byte(&cells[line * 3 + n]));
+    }
+    cell_digits[x] = digit;
+    return 1;
 }
 
-static void set_month()
+// Start wiping the tall digit at x over to digit.  Returns zero if it
+// is not known what is there, or it is digit already, or all the
+// wipes are running; lcd_display_cells() draws it then.
+static uint8_t wipe_start(uint8_t digit, uint8_t x)
 {
-    lcd_gotoxy(4,0);
-    lcd_display_month();
+    uint8_t old = cell_digits[x];
+    uint8_t n;
+
+    if ((old == 0xFF) || (old == digit))
+        return 0;
+    // one still running here jumps to its end
+    for (n = 0; n < WIPES; n++)
+        if (wipes[n].x == x)
+            wipe_draw(n, WIPE_FRAMES);
+    for (n = 0; n < WIPES; n++)
+        if (wipes[n].x == 0xFF)
+            break;
+    if (n == WIPES)
+        return 0;
+
+    wipes[n].x = x;
+    wipes[n].from = old;
+    wipes[n].to = digit;
+    wipes[n].frame = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        wipes[n].start = sched_ticks;
+    }
+    cell_digits[x] = digit;
+    if (!wiping) {
+        wiping = 1;
+        sched_add(&wipe_task, 1);
+    }
+    return 1;
 }
 
-static void set_day()
+// Every WIPE_TICKS while digits are changing: draw the frame each one
+// should be at by now.  A wipe that fell behind, because the task ran
+// late or its glyphs could not be loaded, skips the frames it missed.
+static void wipe_run()
 {
-    lcd_gotoxy(8,0);
-    lcd_display_day();
+    uint16_t ticks, elapsed;
+    uint8_t n, frame;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = sched_ticks;
+    }
+    wiping = 0;
+    power_burst();
+    for (n = 0; n < WIPES; n++) {
+        if (wipes[n].x == 0xFF)
+            continue;
+        elapsed = ticks - wipes[n].start;
+        frame = (elapsed < WIPE_TICKS * (WIPE_FRAMES - 1)) ?
+            elapsed / WIPE_TICKS + 1 : WIPE_FRAMES;
+        wipe_draw(n, frame);
+        if (wipes[n].x != 0xFF)
+            wiping = 1;
+    }
+    power_burst_end();
+    if (!wiping)
+        sched_remove(&wipe_task);
 }
 
-static void set_hour()
+// Draw wipe n at frame.  Only the lines that change from the frame on
+// the screen are written, and the glyphs they need are loaded to CGRAM
+// first, so the frame goes out in one burst of DDRAM writes.  If they
+// can't be loaded the frame is skipped; the last frame has none.
+static void wipe_draw(uint8_t n, uint8_t frame)
 {
-    lcd_gotoxy(4,1);
-    lcd_display_time_attribute(hour, 4, 1);
+    struct wipe *wipe = &wipes[n];
+    uint8_t line = wipe_line(wipe->frame);
+    uint8_t last = wipe_line(frame);
+    uint8_t first, end, c, i;
+
+    if (frame == wipe->frame)
+        return;
+    for (i = line; i <= last; i++) {
+        for (c = 0; c < 3; c++) {
+            first = wipe_cell(n, frame, i, c);
+            if ((first < GLYPHS) && !lcd_glyph_load(first))
+                return;
+        }
+    }
+
+    for (; line <= last; line++) {
+        first = 3;
+        end = 0;
+        for (c = 0; c < 3; c++) {
+            if (wipe_cell(n, wipe->frame, line, c) ==
+                    wipe_cell(n, frame, line, c))
+                continue;
+            if (first == 3)
+                first = c;
+            end = c;
+        }
+        if (first == 3)
+            continue;
+        lcd_gotoxy(wipe->x + first, line);
+        for (c = first; c <= end; c++)
+            lcd_display_big_cell(wipe_cell(n, frame, line, c));
+    }
+    wipe->frame = frame;
+    if (frame == WIPE_FRAMES)
+        wipe->x = 0xFF;
 }
 
-static void set_minute()
+// The line being wiped at frame, two frames to each line.  Tall digits
+// take all four lines.
+static uint8_t wipe_line(uint8_t frame)
 {
-    lcd_gotoxy(7,1);
-    lcd_display_time_attribute(minute, 7, 1);
+    if (frame == 0)
+        return 0;
+    if (frame == WIPE_FRAMES)
+        return 3;
+    return (frame - 1) / 2;
 }
 
-static void set_second()
+// Cell c of line of wipe n at frame: the new digit above the line
+// being wiped, the old one below it.
+static uint8_t wipe_cell(uint8_t n, uint8_t frame, uint8_t line, uint8_t c)
 {
-    lcd_gotoxy(10,1);
-    lcd_display_time_attribute(second, 10, 1);
+    uint8_t from = pgm_read_byte(&tall_font[wipes[n].from][line * 3 + c]);
+    uint8_t to = pgm_read_byte(&tall_font[wipes[n].to][line * 3 + c]);
+
+    if ((frame == 0) || (line > wipe_line(frame)))
+        return from;
+    if ((frame == WIPE_FRAMES) || (line < wipe_line(frame)))
+        return to;
+    return pgm_read_byte(&wipe_cells[(frame - 1) & 1]
+            [wipe_band(from) * 4 + wipe_band(to)]);
 }
 
-static void lcd_display_day()
+// Which of blank, U, L or F a tall font cell is, for wipe_cells.
+static uint8_t wipe_band(uint8_t cell)
 {
-     char buffer[3];
-     lcd_gotoxy(8,0);
-     itoa(day,buffer, 10);
-     lcd_puts(buffer);
+    switch (cell) {
+    case ' ':
+        return 0;
+    case 1:
+        return 1;
+    case 4:
+        return 2;
+    }
+    return 3;
 }
+#endif
 
-static void lcd_display_month()
+// What a field shows, from the time as drawn and the alarm being set.
+static uint16_t layout_value(uint8_t source)
 {
-    lcd_gotoxy(4,0);
-    lcd_puts(months[month -1]);
+    uint8_t days;
+
+    switch (source) {
+    case SOURCE_YEAR:
+        return shown.year;
+    case SOURCE_MONTH:
+        return shown.month;
+    case SOURCE_DAY:
+        return shown.day;
+    case SOURCE_WEEKDAY:
+        return date_weekday(date_days(shown.year, shown.month, shown.day));
+    case SOURCE_HOUR:
+        return shown.hour;
+    case SOURCE_MINUTE:
+        return shown.minute;
+    case SOURCE_SECOND:
+        return shown.second;
+    case SOURCE_ALARM_HOUR:
+        return alarm_edit.hour;
+    case SOURCE_ALARM_MINUTE:
+        return alarm_edit.minute;
+    case SOURCE_ALARM_DAYS:
+        days = alarm_edit.type;
+        if ((days == ALARM_WEEKDAYS) &&
+                (alarm_edit.weekdays == ALARM_SAT_SUN))
+            days++;
+        return days;
+    }
+    return 0;
 }
 
-static void lcd_display_year()
+// Draw one field.
+static void lcd_display_field(const struct layout_field *field)
 {
-    char buffer[5];
-    if (day < 10)
-        lcd_gotoxy(11,0);
-    else 
-        lcd_gotoxy(12,0);
-    itoa(year,buffer, 10);
-    lcd_puts(buffer);
-    if (day < 10) 
-        lcd_putc(' ');
+    uint16_t value;
+    char buffer[6];
+    uint8_t n;
+
+    switch (field->format) {
+    case FORMAT_COLON:
+        lcd_gotoxy(field->x, field->y);
+        lcd_putc(shown_blink ? 0xA5 : ' ');
+        lcd_gotoxy(field->x, field->y + 1);
+        lcd_putc(shown_blink ? 0xA5 : ' ');
+        return;
+#if TALL_FONT
+    case FORMAT_TALL_TENS:
+    case FORMAT_TALL_ONES:
+    case FORMAT_SMALL_TENS:
+    case FORMAT_SMALL_ONES:
+        value = layout_value(field->source);
+        if ((field->format == FORMAT_TALL_TENS) ||
+                (field->format == FORMAT_SMALL_TENS))
+            value /= 10;
+        else
+            value %= 10;
+        if ((field->format < FORMAT_SMALL_TENS) &&
+                wipe_start(value, field->x))
+            return;
+        if (!lcd_display_cells(field->format < FORMAT_SMALL_TENS ?
+                    tall_font[0] : small_font[0],
+                    field->format < FORMAT_SMALL_TENS ? 4 : 2,
+                    value, field->x, field->y))
+            layout_dirty |= field->depends & ~LAYOUT_ENTRY;
+        return;
+#endif
+    }
+
+    lcd_gotoxy(field->x, field->y);
+    switch (field->format) {
+    case FORMAT_CHAR:
+        for (n = 0; n < field->width; n++)
+            lcd_putc(field->source);
+        return;
+    case FORMAT_TEXT:
+        lcd_puts_p(&layout_texts[field->source * 8]);
+        return;
+    case FORMAT_BELL:
+        if (shown_alarm)
+            lcd_putglyph(GLYPH_BELL);
+        else
+            lcd_putc(' ');
+        return;
+    }
+
+    value = layout_value(field->source);
+    switch (field->format) {
+    case FORMAT_NUMBER:
+        utoa(value, buffer, 10);
+        for (n = strlen(buffer); n < field->width; n++)
+            lcd_putc(' ');
+        lcd_puts(buffer);
+        break;
+    case FORMAT_TWO:
+        lcd_putc('0' + value / 10);
+        lcd_putc('0' + value % 10);
+        break;
+    case FORMAT_WEEKDAY:
+        lcd_puts_p(weekday_name(value));
+        break;
+    case FORMAT_MONTH:
+        lcd_puts_p(month_name(value));
+        break;
+    case FORMAT_DAYS:
+        lcd_puts_p(alarm_day_name(value));
+        break;
+    case FORMAT_BIG_TENS:
+        lcd_display_big_glyphs(value / 10, field->x, field->y, field->width);
+        break;
+    case FORMAT_BIG_ONES:
+        lcd_display_big_glyphs(value % 10, field->x, field->y, field->width);
+        break;
+    }
 }
 
-static void lcd_display_weekday()
+// Names in program memory, for lcd_puts_p()
+static const char *weekday_name(uint8_t weekday)
 {
-    uint8_t weekday;
-    weekday = day_of_week(year, month, day);
-    lcd_gotoxy(0,0);
-    lcd_puts(weekdays[weekday]);
+    return &weekday_names[weekday * 4];
 }
 
-static char day_of_week(int year, char month, char day)
+static const char *month_name(uint8_t month)
 {
-    static char table[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
-    year -= month < 3;
-    return (year + year/4 - year/100 + year/400 + table[month-1] + day) % 7;
+    return &month_names[(month - 1) * 4];
 }
 
-// The following function used to be called NthDate and was authored by
-// Mike Szczys.  It can be found at GitHub and has the following License.
-//
-// https://github.com/szczys/Automatic-Daylight-Savings-Time
-//
-// This is free and unencumbered software released into the public domain.
-//
-// Anyone is free to copy, modify, publish, use, compile, sell, or distribute 
-// this software, either in source code form or as a compiled binary, for any 
-// purpose, commercial or non-commercial, and by any means.
-//
-// In jurisdictions that recognize copyright laws, the author or authors of 
-// this software dedicate any and all copyright interest in the software to the 
-// public domain. We make this dedication for the benefit of the public at large
-// and to the detriment of our heirs and successors. We intend this dedication 
-// to be an overt act of relinquishment in perpetuity of all present and future 
-// rights to this software under copyright law.
-//
-// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR 
-// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
-// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE 
-// AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN 
-// ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION 
-// WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-//
-//   For more information, please refer to https://unlicense.org 
+static const char *alarm_day_name(uint8_t days)
+{
+    return &alarm_day_names[days * 8];
+}
+
+#if MARQUEE
+// The date in full and the next alarm scrolling over the time, and
+// with an RTC how much the last sync moved the clock.  What does not
+// fit in the DDRAM line is left out.
+static void lcd_display_marquee()
+{
+    char text[MARQUEE_LENGTH + 1];
+    char line[LCD_DISP_LENGTH + 1];
+    char *end;
+    struct clock_state time;
+    uint32_t next;
+    uint16_t minutes;
 
-static char day_of_month(int year, char month, char dow, char week){
-    char target_date = 1;
-    char first_dow = day_of_week(year, month, target_date);
-    while (first_dow != dow){
-        first_dow = (first_dow+1)%7;
-        target_date++;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        time = now;
+        next = alarm_next;
+    }
+    strcpy_P(text, &weekday_long_names[
+            date_weekday(date_days(time.year, time.month, time.day)) * 10]);
+    strcat_P(text, PSTR(" "));
+    utoa(time.day, text + strlen(text), 10);
+    strcat_P(text, PSTR(" "));
+    strcat_P(text, &month_long_names[(time.month - 1) * 10]);
+    strcat_P(text, PSTR(" "));
+    utoa(time.year, text + strlen(text), 10);
+    if ((next != ALARM_NEVER) && (strlen(text) <= MARQUEE_LENGTH - 17)) {
+        minutes = next % 1440;
+        strcat_P(text, PSTR("   Alarm "));
+        end = text + strlen(text);
+        lcd_format_two(end, minutes / 60, ':');
+        lcd_format_two(end + 3, minutes % 60, 0);
     }
+#if RTC_ENABLE
+    if (strlen(text) <= MARQUEE_LENGTH - 16) {
+        strcat_P(text, PSTR("   RTC "));
+        itoa(sync_drift * (1000 / TICS_PER_SECOND), text + strlen(text), 10);
+        strcat_P(text, PSTR("ms"));
+    }
+#endif
+    marquee_text(text);
 
-    target_date += (week-1)*7;
-    return target_date;
+    memset(line, ' ', LCD_DISP_LENGTH);
+    line[LCD_DISP_LENGTH] = 0;
+    lcd_format_two(&line[(LCD_DISP_LENGTH - 8) / 2], time.hour, ':');
+    lcd_format_two(&line[(LCD_DISP_LENGTH - 2) / 2], time.minute, ':');
+    lcd_format_two(&line[(LCD_DISP_LENGTH + 4) / 2], time.second, ' ');
+    marquee_fixed(line);
+    marquee_step();
 }
 
-// return the day of the first Sunday in November
-static char fall_savings(void) {
-    return (day_of_month(year,month,day_of_week(year,month,day), 1));
+// Two digits of value and then after, not terminated unless after is 0.
+static void lcd_format_two(char *to, uint8_t value, char after)
+{
+    to[0] = '0' + value / 10;
+    to[1] = '0' + value % 10;
+    to[2] = after;
 }
+#endif
 
-// return the day of the second Sunday in March
-static char spring_savings(void) {
-    return (day_of_month(year,month,day_of_week(year,month,day), 2));
+#if DIAG_ENABLE
+static const char *diag_name(uint8_t name)
+{
+    return &diag_names[name * 8];
 }
+#endif
 
-// https://en.wikipedia.org/wiki/Determination_of_the_day_of_the_week
-static char leap_year(int year) {
-    return (((year%4 == 0 && year%100 != 0) || year%400 ==0));
+// A step of the day's sunrise, sunset and moon phase a tick, until
+// they are done.
+static void sun_run()
+{
+    power_burst();
+    if (!sun_step())
+        sched_remove(&sun_task);
+    power_burst_end();
 }
 
-static void lcd_display_clock()
+// Sunrise and sunset, and how much of the moon is lit, drawn once for
+// each day when sun_run() has worked it out.
+static void lcd_display_sun()
 {
-    lcd_display_weekday();
-    lcd_putc(' ');
-    lcd_display_month();
-    lcd_putc(' ');
-    lcd_display_day();
-    lcd_putc(',');
-    lcd_putc(' ');
-    lcd_display_year();
-    lcd_gotoxy(0,1);
-    lcd_putc(' ');
-    lcd_putc(' ');
-    lcd_putc(' ');
-    lcd_putc(' ');
-    lcd_display_time_attribute(hour, 4, 1);
-    lcd_putc(':');
-    lcd_display_time_attribute(minute, 7, 1);
+    struct sun_times sun = sun_today;
+    char text[12];
+    uint8_t octant;
+
+    if (sun.days == sun_shown)
+        return;
+    sun_shown = sun.days;
+    lcd_gotoxy(0, 0);
+    lcd_puts_P("Sun");
+    if (sun.rise < 0) {
+        lcd_gotoxy(LCD_DISP_LENGTH - 11, 0);
+        lcd_puts_p((sun.rise == SUN_ALWAYS_UP) ? PSTR("  always up") :
+                PSTR("always down"));
+    } else {
+        lcd_display_time_attribute(sun.rise / 60, LCD_DISP_LENGTH - 11, 0);
+        lcd_putc(':');
+        lcd_display_time_attribute(sun.rise % 60, LCD_DISP_LENGTH - 8, 0);
+        lcd_display_time_attribute(sun.set / 60, LCD_DISP_LENGTH - 5, 0);
+        lcd_putc(':');
+        lcd_display_time_attribute(sun.set % 60, LCD_DISP_LENGTH - 2, 0);
+    }
+
+    // new and full within a sixteenth of the lunation
+    octant = ((uint8_t)(sun.moon_phase + 16) >> 5) & 7;
+    text[0] = (sun.moon_lit >= 100) ? '1' : ' ';
+    text[1] = (sun.moon_lit >= 10) ? '0' + sun.moon_lit / 10 % 10 : ' ';
+    text[2] = '0' + sun.moon_lit % 10;
+    text[3] = '%';
+    text[4] = ' ';
+    strcpy_P(text + 5, &moon_names[7 * ((octant == 0) ? 0 :
+                (octant < 4) ? 1 : (octant == 4) ? 2 : 3)]);
+    lcd_gotoxy(0, 1);
+    lcd_puts_P("Moon");
+    lcd_gotoxy(LCD_DISP_LENGTH - 11, 1);
+    lcd_puts(text);
+}
+
+// Load the zones other than the clock's own.
+static void world_init()
+{
+    uint8_t n;
+
+    for (n = 1; n < TZ_ZONES; n++)
+        if (tz_load(n, &world_zones[world_count]))
+            world_count++;
+}
+
+// One zone of the world clock on line y: its name, the time, and +1 or
+// -1 if the day is not the clock's own.
+static void lcd_display_zone(struct tz_zone *zone, uint32_t utc, uint8_t y)
+{
+    uint8_t dst;
+    uint32_t stamp = tz_local(zone, now.year, utc, &dst);
+    uint16_t minutes = stamp % 1440;
+    int16_t days = stamp / 1440 - day_stamp / 1440;
+    uint8_t n;
+
+    lcd_gotoxy(0, y);
+    for (n = 0; n < 4; n++)
+        lcd_putc(zone->rule.name[dst][n] ? zone->rule.name[dst][n] : ' ');
+    lcd_display_time_attribute(minutes / 60, LCD_DISP_LENGTH - 8, y);
     lcd_putc(':');
-    lcd_display_time_attribute(second, 10, 1);
-    lcd_putc(' ');
-    lcd_putc(' ');
-    lcd_putc(' ');
+    lcd_display_time_attribute(minutes % 60, LCD_DISP_LENGTH - 5, y);
     lcd_putc(' ');
+    lcd_putc((days > 0) ? '+' : (days < 0) ? '-' : ' ');
+    lcd_putc(days ? '1' : ' ');
 }
 
-static void display_0(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(8);
-    lcd_putc(1);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(3);
-    lcd_putc(4);
-    lcd_putc(5);
-    lcd_putc(20);
-}
-
-static void display_1(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(1);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(20);
-    lcd_putc(255);
-    lcd_putc(20);
-    lcd_putc(20);
-}
-
-static void display_2(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(6);
-    lcd_putc(6);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(3);
-    lcd_putc(7);
-    lcd_putc(7);
-    lcd_putc(20);
-}
-
-static void display_3(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(6);
-    lcd_putc(6);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(7);
-    lcd_putc(7);
-    lcd_putc(5);
-    lcd_putc(20);
-}
-
-static void display_4(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(3);
-    lcd_putc(4);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(20);
-    lcd_putc(20);
-    lcd_putc(255);
-    lcd_putc(20);
-}
-
-static void display_5(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(255);
-    lcd_putc(6);
-    lcd_putc(6);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(7);
-    lcd_putc(7);
-    lcd_putc(5);
-    lcd_putc(20);
-}
-
-static void display_6(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(8);
-    lcd_putc(6);
-    lcd_putc(6);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(3);
-    lcd_putc(7);
-    lcd_putc(5);
-    lcd_putc(20);
-}
-
-static void display_7(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(1);
-    lcd_putc(1);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(20);
-    lcd_putc(8);
-    lcd_putc(20);
-    lcd_putc(20);
-}
-
-static void display_8(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(8);
-    lcd_putc(6);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(3);
-    lcd_putc(7);
-    lcd_putc(5);
-    lcd_putc(20);
-}
-
-static void display_9(uint8_t position)
-{
-    lcd_gotoxy(position,0);
-    lcd_putc(8);
-    lcd_putc(6);
-    lcd_putc(2);
-    lcd_putc(20);
-    lcd_gotoxy(position,1);
-    lcd_putc(20);
-    lcd_putc(20);
-    lcd_putc(255);
-    lcd_putc(20);
+// The clock's zone and the others, one a line.  Everything is worked out
+// from the one UTC time here, and only when the minute changes.
+static void lcd_display_world()
+{
+    uint32_t utc;
+    uint8_t n;
+
+    if (alarm_now == world_minute)
+        return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        world_minute = alarm_now;
+        utc = tz_utc(&local_zone, world_minute, now.dst_active);
+    }
+    lcd_display_zone(&local_zone, utc, 0);
+    for (n = 0; (n < world_count) && (n < LCD_LINES - 1); n++)
+        lcd_display_zone(&world_zones[n], utc, n + 1);
 }
 
-ISR(TIMER1_COMPA_vect)
+// Advance the clock by one second, carrying into minutes, hours and
+// the date.  Called from the timer interrupt, and at startup with
+// interrupts still off.
+static inline void clock_second(void)
 {
-    nsubticks--;
-    if (nsubticks == 0)
+    now.second++;
+    if(now.second > 59)
     {
-        nsubticks = TICS_PER_SECOND;
-        second++;
-        if(second > 59)
+        now.second = 0;
+        now.minute++;
+        if(now.minute > 59)
         {
-            second = 0;
-            minute++;
-            if(minute > 59)
-            {
-                minute = 0;
-                // Set at hour 1 plus minutes 60 (2 am)
-                //
-                // first Sunday in November decrement hour at 2 am
-                // second Sunday in March increment hour at 2 am
-                // (twice)
-                //
-                if((daylight_time == 1) && (month == 3) &&
-                        (hour == 1) &&
-                        (day == spring_savings())) {
-                            hour++;
-                            daylight_time = 0;
-                } else if((daylight_time == 1) && (month == 11) &&
-                        (hour == 1) &&
-                        (day == fall_savings())) {
-                            hour--;
-                            daylight_time = 0;
-                }
-                hour++;
-                if(hour > 23) {
-                    hour = 0;
-                    day++;
-                    if(!leap_year(year))
-                        lastdom = daytab[0][month -1];
-                    else
-                        lastdom = daytab[1][month -1];
-                    if(day > lastdom) {
-                        day = 1;
-                        month++;
-                        daylight_time = 1;
-                        if (month > 12) {
-                            month = 1;
-                            year++;
-                        }
+            now.minute = 0;
+            now.hour++;
+            if(now.hour > 23) {
+                now.hour = 0;
+                now.day++;
+                if(now.day > days_in_month(now.year, now.month)) {
+                    now.day = 1;
+                    now.month++;
+                    if (now.month > 12) {
+                        now.month = 1;
+                        now.year++;
                     }
                 }
+                day_stamp = date_days(now.year, now.month, now.day) * 1440UL;
             }
+            // one compare an hour for daylight saving
+            if (day_stamp + now.hour * 60 == dst_change)
+                clock_dst_change();
         }
+        alarm_now = day_stamp + now.hour * 60 + now.minute;
     }
-    debounce();
+}
+
+// Move the clock on or back for daylight saving.  The change is on the
+// hour and stays within the day, see tz.h.  Housekeeping works out the
+// next one outside the interrupt.
+static inline void clock_dst_change(void)
+{
+    uint16_t minutes = now.hour * 60;
+
+    if (now.dst_active)
+        minutes -= tz_shift(&local_zone);
+    else
+        minutes += tz_shift(&local_zone);
+    now.dst_active = !now.dst_active;
+    now.hour = minutes / 60;
+    now.minute = minutes % 60;
+    dst_change = TZ_NEVER;
+    time_jumped = 1;
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+    power_tick();
+    nsubticks--;
+    if (nsubticks == 0)
+    {
+        nsubticks = TICS_PER_SECOND;
+        if (persist_age != 0xFFFF)
+            persist_age++;
+        clock_second();
+        clock_keep();
+        alarm_check();
+    }
+    kept_subticks = nsubticks;
+    sched_tick();
+    diag_isr();
 }
@@ -1,38 +1,82 @@
 #ifndef CLOCK_H
 #define CLOCK_H
 
+// Screens for a 20x4 LCD, with the four line big clock
+#define TALL_FONT ((LCD_LINES == 4) && (LCD_DISP_LENGTH >= 20))
+// The marquee mode, only on a two line LCD, see marquee.h
+#define MARQUEE (LCD_LINES == 2)
+
 //
 // function prototypes
 // 
 static void buttons_init(void);
 static void timer_init(void);
-static void lcd_display_clock(void);
-static void lcd_display_day(void);
-static void lcd_display_weekday(void);
-static void lcd_display_month(void);
-static void lcd_display_year(void);
-static void set_second(void);
-static void set_minute(void);
-static void set_hour(void);
-static void set_day(void);
-static void set_month(void);
-static void set_year(void);
-static char spring_savings(void);
-static char fall_savings(void);
-static char day_of_week(int, char, char);
-static char day_of_month(int, char, char, char);
-static char leap_year(int);
+static void debounce_run(void);
+static void input_run(void);
+static void render_run(void);
+static void housekeeping_run(void);
+static void clock_restore(void);
+static uint8_t clock_checkpoint(void);
+static uint8_t clock_kept_sum(void);
+static inline void clock_keep(void);
+static uint8_t clock_kept_restore(void);
+static inline void clock_second(void);
+static void clock_stamp(void);
+static void clock_dst_schedule(void);
+static inline void clock_dst_change(void);
+#if RTC_ENABLE || TELEMETRY_ENABLE
+static void clock_get(struct clock_time *);
+static uint32_t clock_seconds(const struct clock_time *);
+#endif
+#if TELEMETRY_ENABLE
+static void clock_telemetry(void);
+#endif
+#if RTC_ENABLE
+static void clock_set(const struct clock_time *);
+static void clock_source_boot(void);
+static void clock_source_write(void);
+static void clock_sync_start(void);
+static void clock_sync_poll(void);
+#endif
+static void world_init(void);
+static void lcd_display_zone(struct tz_zone *, uint32_t, uint8_t);
+static void lcd_display_world(void);
+static void sun_run(void);
+static void lcd_display_sun(void);
+static const char *weekday_name(uint8_t);
+static const char *month_name(uint8_t);
+static const char *alarm_day_name(uint8_t);
+#if MARQUEE
+static void lcd_display_marquee(void);
+static void lcd_format_two(char *, uint8_t, char);
+#endif
+#if DIAG_ENABLE
+static const char *diag_name(uint8_t);
+static void lcd_display_diag_value(uint8_t, uint32_t, uint8_t);
+static void lcd_display_diag(void);
+#endif
 static void lcd_display_time_attribute(uint8_t, uint8_t, uint8_t);
 static void lcd_display_time_attribute_big(uint8_t, uint8_t);
-static void display_0(uint8_t);
-static void display_1(uint8_t);
-static void display_2(uint8_t);
-static void display_3(uint8_t);
-static void display_4(uint8_t);
-static void display_5(uint8_t);
-static void display_6(uint8_t);
-static void display_7(uint8_t);
-static void display_8(uint8_t);
-static void display_9(uint8_t);
+static void lcd_display_big_digit(uint8_t, uint8_t);
+static void lcd_display_big_cell(uint8_t);
+static void lcd_display_big_glyphs(uint8_t, uint8_t, uint8_t, uint8_t);
+static void lcd_display_layout(const struct layout_field *, uint8_t,
+        uint8_t);
+static uint16_t layout_value(uint8_t);
+static void lcd_display_field(const struct layout_field *);
+#if TALL_FONT
+static uint8_t lcd_display_cells(const uint8_t *, uint8_t, uint8_t, uint8_t,
+        uint8_t);
+static uint8_t wipe_start(uint8_t, uint8_t);
+static void wipe_run(void);
+static void wipe_draw(uint8_t, uint8_t);
+static uint8_t wipe_line(uint8_t);
+static uint8_t wipe_cell(uint8_t, uint8_t, uint8_t, uint8_t);
+static uint8_t wipe_band(uint8_t);
+#endif
+static void lcd_display_big_separator(uint8_t, uint8_t);
+static void lcd_display_watch(uint32_t);
+static void lcd_display_lap(void);
+static void lcd_forget_big_digits(void);
 
 #endif // CLOCK_H
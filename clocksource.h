@@ -0,0 +1,31 @@
+// Title:    Clock source interface
+// File:     clocksource.h
+//
+// A clock source is a device that keeps the time by itself, such as a
+// battery backed RTC.  The clock reads it at boot and re-synchronises
+// to it now and then, and writes it when the time is set.
+//
+
+#ifndef CLOCKSOURCE_H
+#define CLOCKSOURCE_H
+
+#include <inttypes.h>
+
+struct clock_time {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+};
+
+struct clock_source {
+    // Read the time.  Returns zero if the device does not answer or
+    // does not hold a valid time.
+    uint8_t (*read)(struct clock_time *time);
+    // Set the time.  Returns zero if the device does not answer.
+    uint8_t (*write)(const struct clock_time *time);
+};
+
+#endif // CLOCKSOURCE_H
@@ -0,0 +1,89 @@
+// Title:    Date arithmetic
+// File:     date.c
+//
+// Years run from March, as in Hinnant's algorithms, so that the leap
+// day is the last of its year.  The range needs only one era, from
+// 1 March 2000, in which 2100 is the one century year that is not a
+// leap year.  Each division is a multiply by a reciprocal and a shift,
+// exact for every day number in range.
+//
+
+#include <avr/pgmspace.h>
+#include "date.h"
+
+// days from 1 March 2000 to 1 January 2020
+#define DATE_EPOCH 7245
+// 1 March 2100, days after 1 March 2000
+#define DATE_2100 36524
+// 1 January 2020 was a Wednesday
+#define DATE_WEEKDAY 3
+
+// days before the first of each month, from March
+static const PROGMEM uint16_t days_before_month[12] = {
+    0, 31, 61, 92, 122, 153, 184, 214, 245, 275, 306, 337
+};
+
+// https://en.wikipedia.org/wiki/Determination_of_the_day_of_the_week
+uint8_t leap_year(uint16_t year)
+{
+    return (((year%4 == 0 && year%100 != 0) || year%400 ==0));
+}
+
+uint8_t days_in_month(uint16_t year, uint8_t month)
+{
+    if (month == 2)
+        return 28 + leap_year(year);
+    if (month == 4 || month == 6 || month == 9 || month == 11)
+        return 30;
+    return 31;
+}
+
+uint16_t date_days(uint16_t year, uint8_t month, uint8_t day)
+{
+    uint8_t years, from_march;
+
+    // January and February end the year before
+    if (month > 2) {
+        years = year - 2000;
+        from_march = month - 3;
+    } else {
+        years = year - 2001;
+        from_march = month + 9;
+    }
+    return years * 365U + (years >> 2) - (years >= 100) +
+        pgm_read_word(&days_before_month[from_march]) + day - 1 -
+        DATE_EPOCH;
+}
+
+void date_civil(uint16_t days, uint16_t *year, uint8_t *month,
+        uint8_t *day)
+{
+    uint16_t era_day = days + DATE_EPOCH;
+    uint16_t year_day;
+    uint8_t years, from_march;
+
+    // (era_day - era_day / 1460 + era_day / 36524) / 365, the days as
+    // if every fourth year had 365 of them
+    years = ((uint32_t)(era_day - (((uint32_t)era_day * 22983) >> 25) +
+                (era_day >= DATE_2100)) * 22983) >> 23;
+    year_day = era_day - (years * 365U + (years >> 2) - (years >= 100));
+    // (5 * year_day + 2) / 153
+    from_march = ((uint32_t)(year_day * 5 + 2) * 857) >> 17;
+    *day = year_day - pgm_read_word(&days_before_month[from_march]) + 1;
+    if (from_march < 10) {
+        *month = from_march + 3;
+        *year = 2000 + years;
+    } else {
+        *month = from_march - 9;
+        *year = 2001 + years;
+    }
+}
+
+uint8_t date_weekday(uint16_t days)
+{
+    // 256 days are 36 weeks and 4 days, then (x * 1171) >> 13 is x / 7
+    // for x up to 942
+    uint16_t x = (days >> 8) * 4 + (days & 0xFF) + DATE_WEEKDAY;
+
+    return x - (((uint32_t)x * 1171) >> 13) * 7;
+}
@@ -0,0 +1,32 @@
+// Title:    Date arithmetic
+// File:     date.h
+//
+// Dates are Gregorian, years 2020 - 2119, the range the clock can be
+// set to.  A date is also a day number, days since 1 January 2020,
+// which fits in 16 bits; date_days() and date_civil() convert between
+// the two in a fixed number of steps, after Howard Hinnant's
+// days_from_civil() and civil_from_days().
+//
+
+#ifndef DATE_H
+#define DATE_H
+
+#include <inttypes.h>
+
+// Non-zero if year is a leap year.
+uint8_t leap_year(uint16_t year);
+
+// Number of days in month (1 - 12) of year.
+uint8_t days_in_month(uint16_t year, uint8_t month);
+
+// Days since 1 January 2020.
+uint16_t date_days(uint16_t year, uint8_t month, uint8_t day);
+
+// The date days since 1 January 2020.
+void date_civil(uint16_t days, uint16_t *year, uint8_t *month,
+        uint8_t *day);
+
+// Day of the week days since 1 January 2020, 0 for Sunday.
+uint8_t date_weekday(uint16_t days);
+
+#endif // DATE_H
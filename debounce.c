@@ -9,6 +9,8 @@
 // Bite is set to one if a debounced press is detected
 volatile uint8_t buttons_down;
 
+uint8_t button_presses[3];
+
 // Return non-zero if a button matching mask is pressed
 uint8_t button_down(uint8_t button_mask)
 {
@@ -24,6 +24,9 @@
 // Can be read with button_down() which will clear it.
 extern volatile uint8_t buttons_down;
 
+// Presses of buttons 0, 1 and 2 since reset, wrapping at 256.
+extern uint8_t button_presses[3];
+
 // Return non-zero if a button matching mask is pressed.
 uint8_t button_down(uint8_t button_mask);
 
@@ -57,7 +60,15 @@ static inline void debounce (void)
 
     // Update button_down with buttons who's counters rolled over
     // and who's state us 1 (pressed)
-    buttons_down |= button_state & state_changed;
+    state_changed &= button_state;
+    buttons_down |= state_changed;
+
+    if (state_changed & BUTTON0_MASK)
+        button_presses[0]++;
+    if (state_changed & BUTTON1_MASK)
+        button_presses[1]++;
+    if (state_changed & BUTTON2_MASK)
+        button_presses[2]++;
 }
 
 #endif /* DEBOUNCE_H */
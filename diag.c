@@ -0,0 +1,55 @@
+// Title:    Diagnostics
+// File:     diag.c
+//
+
+#include <util/atomic.h>
+#include "lcd.h"
+#include "stackmon.h"
+#include "power.h"
+#include "diag.h"
+
+#if DIAG_ENABLE
+
+struct diag diag;
+volatile uint16_t diag_isr_peak;
+volatile uint32_t diag_isr_total;
+volatile uint8_t diag_isr_count;
+uint16_t diag_loop_count;
+
+void diag_second(void)
+{
+    uint32_t total;
+    uint8_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        diag.isr_max = diag_isr_peak;
+        total = diag_isr_total;
+        count = diag_isr_count;
+        diag_isr_total = 0;
+        diag_isr_count = 0;
+        diag.fast_ticks = power_fast;
+        power_fast = 0;
+    }
+    diag.isr_avg = count ? total / count : 0;
+    diag.loops = diag_loop_count;
+    diag_loop_count = 0;
+#if LCD_STATS
+    diag.lcd_bytes = lcd_bytes;
+    diag.lcd_spins = lcd_spins;
+    lcd_bytes = 0;
+    lcd_spins = 0;
+#endif
+    diag.stack_used = stack_size() - stack_unused();
+    diag.uptime++;
+}
+
+void diag_reset_max(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        diag_isr_peak = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,75 @@
+// Title:    Diagnostics
+// File:     diag.h
+//
+// Counters for the hidden diagnostics screen.  The hooks in the timer
+// interrupt and the main loop take a few instructions and compile to
+// nothing with DIAG_ENABLE set to 0.
+//
+
+#ifndef DIAG_H
+#define DIAG_H
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include "power.h"
+
+#ifndef DIAG_ENABLE
+#define DIAG_ENABLE 1
+#endif
+
+// Taken by diag_second() once a second.
+struct diag {
+    uint16_t isr_max;       // longest timer interrupt since reset, cycles
+    uint16_t isr_avg;       // average timer interrupt in the last second
+    uint16_t loops;         // main loop passes in the last second
+    uint16_t lcd_bytes;     // bytes written to the LCD in the last second
+    uint16_t lcd_spins;     // LCD busy flag reads in the last second
+    uint16_t stack_used;    // most RAM the stack has taken since reset
+    uint16_t fast_ticks;    // ticks at full speed in the last second
+    uint32_t uptime;        // seconds since reset
+};
+
+#if DIAG_ENABLE
+
+extern struct diag diag;
+extern volatile uint16_t diag_isr_peak;
+extern volatile uint32_t diag_isr_total;
+extern volatile uint8_t diag_isr_count;
+extern uint16_t diag_loop_count;
+
+// Call at the very end of the timer interrupt.  Timer 1 runs without a
+// prescaler and restarts at the compare match that raised the
+// interrupt, so TCNT1 is the CPU cycles taken to get here.  They are
+// counted as crystal cycles, the same at either speed.
+static inline void diag_isr(void)
+{
+    uint16_t cycles = power_cycles(TCNT1);
+
+    if (cycles > diag_isr_peak)
+        diag_isr_peak = cycles;
+    diag_isr_total += cycles;
+    diag_isr_count++;
+}
+
+// Call once per main loop pass.
+static inline void diag_loop(void)
+{
+    diag_loop_count++;
+}
+
+// Take the snapshot in diag.  Call once a second.
+void diag_second(void);
+
+// Forget the longest interrupt seen.
+void diag_reset_max(void);
+
+#else
+
+static inline void diag_isr(void) {}
+static inline void diag_loop(void) {}
+static inline void diag_second(void) {}
+static inline void diag_reset_max(void) {}
+
+#endif
+
+#endif // DIAG_H
@@ -0,0 +1,27 @@
+// Title:    EEPROM map
+// File:     eemap.h
+//
+// Every EEPROM user gets a fixed address here rather than an EEMEM
+// variable, so that data written by one firmware build is still found
+// after the chip is reflashed with another.  The ATmega162 has 512
+// bytes of EEPROM (0x000 - 0x1FF).
+//
+
+#ifndef EEMAP_H
+#define EEMAP_H
+
+// Wear-leveled ring of clock checkpoints, see persist.c
+#define EEMAP_PERSIST_RING      0x000
+#define EEMAP_PERSIST_SLOTS     16
+#define EEMAP_PERSIST_SLOT_SIZE 16
+
+// Last gasp record written on power failure, see persist_lastgasp()
+#define EEMAP_LASTGASP          0x100
+
+// Alarm settings, ALARM_COUNT entries of struct alarm, see alarm.c
+#define EEMAP_ALARMS            0x110
+
+// Time zone rules, TZ_ZONES records of TZ_RECORD_SIZE, see tz.h
+#define EEMAP_TZ                0x180
+
+#endif // EEMAP_H
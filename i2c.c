@@ -0,0 +1,98 @@
+// Title:    Software I2C master
+// File:     i2c.c
+//
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include "i2c.h"
+
+#define DDR(x) (*(&x - 1))
+#define PIN(x) (*(&x - 2))
+
+// half a bit time at 100 kHz
+#define I2C_DELAY()     _delay_us(5)
+// give up on a device that holds SCL low longer than this, in delays
+#define I2C_STRETCH_MAX 200
+
+#define sda_low()       DDR(I2C_PORT) |= _BV(I2C_SDA)
+#define sda_high()      DDR(I2C_PORT) &= ~_BV(I2C_SDA)
+#define scl_low()       DDR(I2C_PORT) |= _BV(I2C_SCL)
+#define sda_read()      (PIN(I2C_PORT) & _BV(I2C_SDA))
+
+// release SCL and wait for any slave stretching the clock
+static void scl_high(void)
+{
+    uint8_t n = I2C_STRETCH_MAX;
+
+    DDR(I2C_PORT) &= ~_BV(I2C_SCL);
+    while (!(PIN(I2C_PORT) & _BV(I2C_SCL)) && --n)
+        I2C_DELAY();
+}
+
+void i2c_init(void)
+{
+    I2C_PORT &= ~(_BV(I2C_SDA) | _BV(I2C_SCL));
+    sda_high();
+    scl_high();
+}
+
+static uint8_t i2c_bit(uint8_t bit)
+{
+    if (bit)
+        sda_high();
+    else
+        sda_low();
+    I2C_DELAY();
+    scl_high();
+    I2C_DELAY();
+    bit = sda_read() ? 1 : 0;
+    scl_low();
+    return bit;
+}
+
+uint8_t i2c_write(uint8_t data)
+{
+    uint8_t n;
+
+    for (n = 0; n < 8; n++) {
+        i2c_bit(data & 0x80);
+        data <<= 1;
+    }
+    // ACK is the slave pulling SDA low
+    return !i2c_bit(1);
+}
+
+uint8_t i2c_read(uint8_t ack)
+{
+    uint8_t data = 0;
+    uint8_t n;
+
+    for (n = 0; n < 8; n++)
+        data = (data << 1) | i2c_bit(1);
+    i2c_bit(!ack);
+    return data;
+}
+
+uint8_t i2c_start(uint8_t address, uint8_t direction)
+{
+    // SDA falls while SCL is high; also works as a repeated start
+    sda_high();
+    I2C_DELAY();
+    scl_high();
+    I2C_DELAY();
+    sda_low();
+    I2C_DELAY();
+    scl_low();
+    return i2c_write((address << 1) | direction);
+}
+
+void i2c_stop(void)
+{
+    // SDA rises while SCL is high
+    sda_low();
+    I2C_DELAY();
+    scl_high();
+    I2C_DELAY();
+    sda_high();
+    I2C_DELAY();
+}
@@ -0,0 +1,46 @@
+// Title:    Software I2C master
+// File:     i2c.h
+//
+// The ATmega162 has no TWI, so the bus is bit-banged.  Both lines are
+// driven open drain by switching the pin between output low and input;
+// the pull-up resistors are external.  Runs at roughly 100 kHz.
+//
+
+#ifndef I2C_H
+#define I2C_H
+
+#include <inttypes.h>
+#include <avr/io.h>
+
+#ifndef I2C_PORT
+#define I2C_PORT    PORTB
+#endif
+#ifndef I2C_SDA
+#define I2C_SDA     PB0
+#endif
+#ifndef I2C_SCL
+#define I2C_SCL     PB1
+#endif
+
+#define I2C_READ    1
+#define I2C_WRITE   0
+
+// Release both lines.
+void i2c_init(void);
+
+// Send a start (or repeated start) condition and the address byte.
+// address is the 7-bit address, direction I2C_READ or I2C_WRITE.
+// Returns non-zero if the device acknowledged.
+uint8_t i2c_start(uint8_t address, uint8_t direction);
+
+// Send a stop condition.
+void i2c_stop(void);
+
+// Send one byte.  Returns non-zero if the device acknowledged.
+uint8_t i2c_write(uint8_t data);
+
+// Receive one byte, acknowledge it if ack is non-zero.  The last byte
+// of a read must not be acknowledged.
+uint8_t i2c_read(uint8_t ack);
+
+#endif // I2C_H
@@ -0,0 +1,19 @@
+// Title:    Screen layouts
+// File:     layout.c
+//
+
+#include <avr/pgmspace.h>
+#include "layout.h"
+
+void layout_render(const struct layout_field *table, uint8_t count,
+        uint8_t dirty, void (*draw)(const struct layout_field *field))
+{
+    struct layout_field field;
+
+    while (count--) {
+        memcpy_P(&field, table++, sizeof(field));
+        if (!(field.depends & dirty))
+            continue;
+        draw(&field);
+    }
+}
@@ -0,0 +1,46 @@
+// Title:    Screen layouts
+// File:     layout.h
+//
+// A screen is a table of fields in program memory: where each one goes,
+// how it is drawn and what it shows.  layout_render() goes through the
+// table and draws the fields that depend on something that changed,
+// so the screens for a 20x4 display are just other tables.
+//
+// What a field shows and how is up to the caller's draw function;
+// format and source are its own numbers.
+//
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <inttypes.h>
+
+// What fields depend on, passed to layout_render() as what changed
+#define LAYOUT_SECOND   0x01
+#define LAYOUT_MINUTE   0x02
+#define LAYOUT_HOUR     0x04
+#define LAYOUT_DATE     0x08    // day, month or year
+#define LAYOUT_ALARM    0x10    // whether an alarm is armed
+#define LAYOUT_EDIT     0x20    // the alarm being set
+#define LAYOUT_BLINK    0x40    // a blinking field turns on or off
+#define LAYOUT_ENTRY    0x80    // the screen was just shown, or cleared
+#define LAYOUT_ALL      0xFF
+
+struct layout_field {
+    uint8_t x;
+    uint8_t y;
+    uint8_t width;          // cells, for formats that pad
+    uint8_t format;
+    uint8_t source;
+    uint8_t depends;        // LAYOUT_ bits
+};
+
+#define LAYOUT_FIELDS(table) (sizeof(table) / sizeof(table[0]))
+
+// Draw the first count fields of table, in program memory, that depend
+// on one of dirty.  draw puts the cursor where it needs it, so a field
+// that only rewrites some of its cells can skip the rest.
+void layout_render(const struct layout_field *table, uint8_t count,
+        uint8_t dirty, void (*draw)(const struct layout_field *field));
+
+#endif // LAYOUT_H
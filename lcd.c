@@ -47,12 +47,31 @@
 #define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
 #define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
 #define lcd_e_toggle()  toggle_e()
+#if LCD_RW_TIED_LOW
+#define lcd_rw_low()
+#else
 #define lcd_rw_high()   LCD_RW_PORT |=  _BV(LCD_RW_PIN)
 #define lcd_rw_low()    LCD_RW_PORT &= ~_BV(LCD_RW_PIN)
+#endif
 #define lcd_rs_high()   LCD_RS_PORT |=  _BV(LCD_RS_PIN)
 #define lcd_rs_low()    LCD_RS_PORT &= ~_BV(LCD_RS_PIN)
 #endif
 
+#if LCD_IO_MODE
+/* port bits of data line i on port for nibble n, worked out by the compiler from the pin definitions */
+#define LCD_DATA_BIT(port,i,n)  ( ((&LCD_DATA##i##_PORT == &(port)) && ((n) & (1<<i))) ? _BV(LCD_DATA##i##_PIN) : 0 )
+#define LCD_NIBBLE(port,n)      ( LCD_DATA_BIT(port,0,n) | LCD_DATA_BIT(port,1,n) | LCD_DATA_BIT(port,2,n) | LCD_DATA_BIT(port,3,n) )
+#define LCD_NIBBLE_ROW(port)    { LCD_NIBBLE(port,0),  LCD_NIBBLE(port,1),  LCD_NIBBLE(port,2),  LCD_NIBBLE(port,3),  \
+                                  LCD_NIBBLE(port,4),  LCD_NIBBLE(port,5),  LCD_NIBBLE(port,6),  LCD_NIBBLE(port,7),  \
+                                  LCD_NIBBLE(port,8),  LCD_NIBBLE(port,9),  LCD_NIBBLE(port,10), LCD_NIBBLE(port,11), \
+                                  LCD_NIBBLE(port,12), LCD_NIBBLE(port,13), LCD_NIBBLE(port,14), LCD_NIBBLE(port,15) }
+/* data line i is the first on its port */
+#define LCD_DATA1_FIRST  ( &LCD_DATA1_PORT != &LCD_DATA0_PORT )
+#define LCD_DATA2_FIRST  ( (&LCD_DATA2_PORT != &LCD_DATA0_PORT) && (&LCD_DATA2_PORT != &LCD_DATA1_PORT) )
+#define LCD_DATA3_FIRST  ( (&LCD_DATA3_PORT != &LCD_DATA0_PORT) && (&LCD_DATA3_PORT != &LCD_DATA1_PORT) \
+                        && (&LCD_DATA3_PORT != &LCD_DATA2_PORT) )
+#endif
+
 #if LCD_IO_MODE
 #if LCD_LINES==1
 #define LCD_FUNCTION_DEFAULT    LCD_FUNCTION_4BIT_1LINE 
@@ -84,6 +103,55 @@
 static void toggle_e(void);
 #endif
 
+
+/*
+** global variables
+*/
+uint8_t lcd_fault;
+#if LCD_STATS
+uint16_t lcd_bytes;
+uint16_t lcd_spins;
+#define lcd_count(n) (n)++
+#else
+#define lcd_count(n)
+#endif
+
+
+#if LCD_RW_TIED_LOW
+/*
+** with R/W tied low the address counter is tracked here instead of read
+*/
+static uint8_t lcdAddress;      /* address counter                                   */
+static uint8_t lcdCgram;        /* address counter points into CGRAM                  */
+static uint8_t lcdDecrement;    /* entry mode decrements the address counter          */
+static uint8_t lcdWait;         /* 0: idle, 1: instruction running, 2: clear or home */
+#endif
+
+
+#if LCD_GLYPH_CACHE
+/*
+** glyph cache state; what is in CGRAM and on the screen is kept over a
+** reset in .noinit for lcd_init_warm(), glyphCheck is 0xA5 plus the sum
+** of the other bytes kept
+*/
+#define LCD_NOINIT        __attribute__((section(".noinit")))
+#define LCD_GLYPH_BLANK   0xFF          /* CGRAM character is all zero */
+#define LCD_GLYPH_UNKNOWN 0xFE          /* CGRAM character holds a glyph of another library */
+static const uint8_t *glyphLibrary LCD_NOINIT;
+static uint8_t glyphCount LCD_NOINIT;
+static uint8_t slotGlyph[LCD_GLYPH_SLOTS] LCD_NOINIT;   /* glyph held by each CGRAM character */
+static uint8_t cellSlot[LCD_LINES*LCD_DISP_LENGTH] LCD_NOINIT; /* CGRAM character+1 in each cell, 0: none */
+static uint8_t glyphCheck LCD_NOINIT;
+static uint8_t glyphClock;
+static uint8_t slotRefs[LCD_GLYPH_SLOTS];     /* cells on the screen showing it              */
+static uint8_t slotUsed[LCD_GLYPH_SLOTS];     /* glyphClock when it was last used            */
+
+/* change a byte covered by glyphCheck */
+#define lcd_glyph_keep(var,value) { glyphCheck += (uint8_t)((value)-(var)); (var) = (value); }
+#else
+static uint8_t glyphCount;
+#endif
+
 /*
 ** local functions
 */
@@ -97,6 +165,37 @@ the number of loops is calculated at compile-time from MCU clock frequency
 
 
 #if LCD_IO_MODE
+/*
+** bits to output on the port of each data line for each nibble, when the
+** data lines are not bits 0-3 of one port
+*/
+static const PROGMEM uint8_t lcdNibbleBits[4][16] = {
+    LCD_NIBBLE_ROW(LCD_DATA0_PORT),
+    LCD_NIBBLE_ROW(LCD_DATA1_PORT),
+    LCD_NIBBLE_ROW(LCD_DATA2_PORT),
+    LCD_NIBBLE_ROW(LCD_DATA3_PORT)
+};
+
+
+/* output the bits of nibble on the port of data line i, a single line with sbi/cbi, more with one masked write */
+#define lcd_nibble_port(i,nibble) \
+    if ( (LCD_NIBBLE(LCD_DATA##i##_PORT,0x0F) & (LCD_NIBBLE(LCD_DATA##i##_PORT,0x0F)-1)) == 0 ) { \
+        if ( (nibble) & (1<<i) ) LCD_DATA##i##_PORT |= _BV(LCD_DATA##i##_PIN); \
+        else LCD_DATA##i##_PORT &= ~_BV(LCD_DATA##i##_PIN); \
+    } else { \
+        LCD_DATA##i##_PORT = (LCD_DATA##i##_PORT & ~LCD_NIBBLE(LCD_DATA##i##_PORT,0x0F)) \
+                           | pgm_read_byte(&lcdNibbleBits[i][nibble]); \
+    }
+
+static inline void lcd_nibble_out(uint8_t nibble)
+{
+    lcd_nibble_port(0,nibble);
+    if ( LCD_DATA1_FIRST ) { lcd_nibble_port(1,nibble); }
+    if ( LCD_DATA2_FIRST ) { lcd_nibble_port(2,nibble); }
+    if ( LCD_DATA3_FIRST ) { lcd_nibble_port(3,nibble); }
+}
+
+
 /* toggle Enable Pin to initiate write */
 static void toggle_e(void)
 {
@@ -107,6 +206,65 @@ static void toggle_e(void)
 #endif
 
 
+#if LCD_RW_TIED_LOW
+/*************************************************************************
+Follow what a byte written to the LCD controller does to the address
+counter, and how long it takes to execute
+Input:    data   byte written to LCD
+          rs     1: data, 0: instruction
+Returns:  none
+*************************************************************************/
+static void lcd_track(uint8_t data, uint8_t rs)
+{
+    uint8_t step = 0;           /* 1: address counter incremented, 0xFF: decremented */
+
+
+    lcdWait = 1;
+    if (rs) {
+        step = lcdDecrement ? 0xFF : 1;
+    } else if ( data & (1<<LCD_DDRAM) ) {
+        lcdAddress = data & 0x7F;
+        lcdCgram = 0;
+    } else if ( data & (1<<LCD_CGRAM) ) {
+        lcdAddress = data & 0x3F;
+        lcdCgram = 1;
+    } else if ( data & (1<<LCD_FUNCTION) ) {
+        ;
+    } else if ( data & (1<<LCD_MOVE) ) {
+        if ( !(data & (1<<LCD_MOVE_DISP)) )
+            step = (data & (1<<LCD_MOVE_RIGHT)) ? 1 : 0xFF;
+    } else if ( data & (1<<LCD_ON) ) {
+        ;
+    } else if ( data & (1<<LCD_ENTRY_MODE) ) {
+        lcdDecrement = !(data & (1<<LCD_ENTRY_INC));
+    } else if ( data & ((1<<LCD_HOME)|(1<<LCD_CLR)) ) {
+        if ( data & (1<<LCD_CLR) )
+            lcdDecrement = 0;   /* clear display also sets increment mode */
+        lcdAddress = 0;
+        lcdCgram = 0;
+        lcdWait = 2;
+    }
+
+    if (step) {
+        lcdAddress += step;
+        if (lcdCgram) {
+            lcdAddress &= 0x3F;
+        }
+#if LCD_LINES==1
+        else if ( lcdAddress == 0x50 ) lcdAddress = 0x00;
+        else if ( lcdAddress == 0xFF ) lcdAddress = 0x4F;
+#else
+        else if ( lcdAddress == 0x28 ) lcdAddress = 0x40;
+        else if ( lcdAddress == 0x68 ) lcdAddress = 0x00;
+        else if ( lcdAddress == 0x3F ) lcdAddress = 0x27;
+        else if ( lcdAddress == 0xFF ) lcdAddress = 0x67;
+#endif
+    }
+
+}/* lcd_track */
+#endif
+
+
 /*************************************************************************
 Low-level function to write byte to LCD controller
 Input:    data   byte to write to LCD
@@ -120,6 +278,7 @@ static void lcd_write(uint8_t data,uint8_t rs)
     unsigned char dataBits ;
 
 
+    lcd_count(lcd_bytes);
     if (rs) {        /* write data        (RS=1, RW=0) */
        lcd_rs_high();
     } else {         /* write instruction (RS=0, RW=0) */
@@ -148,44 +307,45 @@ static void lcd_write(uint8_t data,uint8_t rs)
     else
     {
         /* configure data pins as output */
-        DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
-        DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
-        DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
-        DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
+        DDR(LCD_DATA0_PORT) |= LCD_NIBBLE(LCD_DATA0_PORT,0x0F);
+        if ( LCD_DATA1_FIRST ) DDR(LCD_DATA1_PORT) |= LCD_NIBBLE(LCD_DATA1_PORT,0x0F);
+        if ( LCD_DATA2_FIRST ) DDR(LCD_DATA2_PORT) |= LCD_NIBBLE(LCD_DATA2_PORT,0x0F);
+        if ( LCD_DATA3_FIRST ) DDR(LCD_DATA3_PORT) |= LCD_NIBBLE(LCD_DATA3_PORT,0x0F);
         
         /* output high nibble first */
-        LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
-        LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
-        LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
-        LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
-        if(data & 0x80) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-        if(data & 0x40) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-        if(data & 0x20) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-        if(data & 0x10) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);   
+        lcd_nibble_out(data>>4);
         lcd_e_toggle();
         
         /* output low nibble */
-        LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
-        LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
-        LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
-        LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
-        if(data & 0x08) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
-        if(data & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-        if(data & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-        if(data & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
+        lcd_nibble_out(data&0x0F);
         lcd_e_toggle();        
         
         /* all data pins high (inactive) */
-        LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-        LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
-        LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
-        LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
+        lcd_nibble_out(0x0F);
     }
+#if LCD_RW_TIED_LOW
+    lcd_track(data, rs);
+#endif
+}
+#elif LCD_RW_TIED_LOW
+static void lcd_write(uint8_t data,uint8_t rs) 
+{
+    lcd_count(lcd_bytes);
+    if (rs)
+        *(volatile uint8_t*)(LCD_IO_DATA) = data;
+    else
+        *(volatile uint8_t*)(LCD_IO_FUNCTION) = data;
+    lcd_track(data, rs);
 }
 #else
-#define lcd_write(d,rs) if (rs) *(volatile uint8_t*)(LCD_IO_DATA) = d; else *(volatile uint8_t*)(LCD_IO_FUNCTION) = d;
-/* rs==0 -> write instruction to LCD_IO_FUNCTION */
-/* rs==1 -> write data to LCD_IO_DATA */
+static inline void lcd_write(uint8_t data,uint8_t rs) 
+{
+    lcd_count(lcd_bytes);
+    if (rs)
+        *(volatile uint8_t*)(LCD_IO_DATA) = data;        /* rs==1 -> write data to LCD_IO_DATA */
+    else
+        *(volatile uint8_t*)(LCD_IO_FUNCTION) = data;    /* rs==0 -> write instruction to LCD_IO_FUNCTION */
+}
 #endif
 
 
@@ -195,7 +355,9 @@ Input:    rs     1: read data
                  0: read busy flag / address counter
 Returns:  byte read from LCD controller
 *************************************************************************/
-#if LCD_IO_MODE
+#if LCD_RW_TIED_LOW
+/* nothing can be read */
+#elif LCD_IO_MODE
 static uint8_t lcd_read(uint8_t rs) 
 {
     uint8_t data;
@@ -256,7 +418,7 @@ static uint8_t lcd_read(uint8_t rs)
     return data;
 }
 #else
-#define lcd_read(rs) (rs) ? *(volatile uint8_t*)(LCD_IO_DATA+LCD_IO_READ) : *(volatile uint8_t*)(LCD_IO_FUNCTION+LCD_IO_READ)
+#define lcd_read(rs) ((rs) ? *(volatile uint8_t*)(LCD_IO_DATA+LCD_IO_READ) : *(volatile uint8_t*)(LCD_IO_FUNCTION+LCD_IO_READ))
 /* rs==0 -> read instruction from LCD_IO_FUNCTION */
 /* rs==1 -> read data from LCD_IO_DATA */
 #endif
@@ -265,13 +427,37 @@ static uint8_t lcd_read(uint8_t rs)
 /*************************************************************************
 loops while lcd is busy, returns address counter
 *************************************************************************/
+#if LCD_RW_TIED_LOW
+static uint8_t lcd_waitbusy(void)
+{
+    /* no busy flag, wait until the last instruction has been executed */
+    if (lcdWait == 2)
+        delay(LCD_DELAY_EXEC_LONG);
+    else if (lcdWait)
+        delay(LCD_DELAY_EXEC);
+    lcdWait = 0;
+
+    return lcdAddress;
+
+}/* lcd_waitbusy */
+#else
 static uint8_t lcd_waitbusy(void)
 
 {
     register uint8_t c;
+    uint16_t loops = LCD_BUSY_LOOPS;
     
-    /* wait until busy flag is cleared */
-    while ( (c=lcd_read(0)) & (1<<LCD_BUSY)) {}
+    if (lcd_fault)
+        return 0;
+
+    /* wait until busy flag is cleared, give up if the LCD does not answer */
+    while ( (c=lcd_read(0)) & (1<<LCD_BUSY)) {
+        lcd_count(lcd_spins);
+        if (--loops == 0) {
+            lcd_fault = 1;
+            return 0;
+        }
+    }
     
     /* the address counter is updated 4us after the busy flag is cleared */
     delay(LCD_DELAY_BUSY_FLAG);
@@ -280,6 +466,102 @@ static uint8_t lcd_waitbusy(void)
     return (lcd_read(0));  // return address counter
     
 }/* lcd_waitbusy */
+#endif
+
+
+#if LCD_GLYPH_CACHE
+/*************************************************************************
+Return the index of the visible cell at DDRAM address pos, 0xFF if the
+address is not visible
+*************************************************************************/
+static uint8_t lcd_cell(uint8_t pos)
+{
+    if ( (pos >= LCD_START_LINE1) && (pos < LCD_START_LINE1+LCD_DISP_LENGTH) )
+        return pos-LCD_START_LINE1;
+#if LCD_LINES>1
+    if ( (pos >= LCD_START_LINE2) && (pos < LCD_START_LINE2+LCD_DISP_LENGTH) )
+        return LCD_DISP_LENGTH+pos-LCD_START_LINE2;
+#endif
+#if LCD_LINES>2
+    if ( (pos >= LCD_START_LINE3) && (pos < LCD_START_LINE3+LCD_DISP_LENGTH) )
+        return 2*LCD_DISP_LENGTH+pos-LCD_START_LINE3;
+    if ( (pos >= LCD_START_LINE4) && (pos < LCD_START_LINE4+LCD_DISP_LENGTH) )
+        return 3*LCD_DISP_LENGTH+pos-LCD_START_LINE4;
+#endif
+    return 0xFF;
+
+}/* lcd_cell */
+
+
+/*************************************************************************
+The cell at DDRAM address pos is about to be overwritten, drop its
+reference to a CGRAM character. Returns the cell index.
+*************************************************************************/
+static uint8_t lcd_cell_release(uint8_t pos)
+{
+    uint8_t cell = lcd_cell(pos);
+
+    if ( (cell != 0xFF) && cellSlot[cell] ) {
+        slotRefs[cellSlot[cell]-1]--;
+        lcd_glyph_keep(cellSlot[cell], 0);
+    }
+    return cell;
+
+}/* lcd_cell_release */
+
+
+/*************************************************************************
+Return what glyphCheck should be
+*************************************************************************/
+static uint8_t lcd_glyph_sum(void)
+{
+    uint8_t i, sum;
+
+    sum = 0xA5 + glyphCount + (uint8_t)(uint16_t)glyphLibrary + (uint8_t)((uint16_t)glyphLibrary>>8);
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++)
+        sum += slotGlyph[i];
+    for (i = 0; i < LCD_LINES*LCD_DISP_LENGTH; i++)
+        sum += cellSlot[i];
+    return sum;
+
+}/* lcd_glyph_sum */
+
+
+/*************************************************************************
+Forget which CGRAM characters are on the screen
+*************************************************************************/
+static void lcd_cells_clear(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < LCD_LINES*LCD_DISP_LENGTH; i++)
+        cellSlot[i] = 0;
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++)
+        slotRefs[i] = 0;
+    glyphCheck = lcd_glyph_sum();
+
+}/* lcd_cells_clear */
+
+
+/*************************************************************************
+Clear CGRAM and forget the glyph cache, after power-on
+*************************************************************************/
+static void lcd_glyph_reset(void)
+{
+    uint8_t i;
+
+    lcd_command(1<<LCD_CGRAM);
+    for (i = 0; i < 8*LCD_GLYPH_SLOTS; i++)
+        lcd_data(0);
+    lcd_command(1<<LCD_DDRAM);
+    glyphLibrary = 0;
+    glyphCount = 0;
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++)
+        slotGlyph[i] = LCD_GLYPH_BLANK;
+    lcd_cells_clear();
+
+}/* lcd_glyph_reset */
+#endif
 
 
 /*************************************************************************
@@ -394,12 +676,40 @@ int lcd_getxy(void)
 }
 
 
+/*************************************************************************
+Check that the busy flag and address counter can be read back
+Returns:  1 if the LCD answered, 0 if not
+*************************************************************************/
+uint8_t lcd_probe(void)
+{
+#if LCD_RW_TIED_LOW
+    lcd_clrscr();                         /* nothing can be read back */
+    return 1;
+#else
+    uint8_t busy;
+
+
+    lcd_clrscr();                         /* takes 1.52ms, busy flag must be set */
+    busy = lcd_read(0) & (1<<LCD_BUSY);
+    lcd_gotoxy(5,0);
+    if ( !busy || (lcd_getxy() != LCD_START_LINE1+5) )
+        return 0;
+    lcd_gotoxy(2,0);
+    return (lcd_getxy() == LCD_START_LINE1+2);
+#endif
+
+}/* lcd_probe */
+
+
 /*************************************************************************
 Clear display and set cursor to home position
 *************************************************************************/
 void lcd_clrscr(void)
 {
     lcd_command(1<<LCD_CLR);
+#if LCD_GLYPH_CACHE
+    lcd_cells_clear();
+#endif
 }
 
 
@@ -451,7 +761,10 @@ void lcd_putc(char c)
             lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
         }
 #endif
-        lcd_waitbusy();
+        pos = lcd_waitbusy();
+#endif
+#if LCD_GLYPH_CACHE
+        lcd_cell_release(pos);
 #endif
         lcd_write(c, 1);
     }
@@ -493,22 +806,165 @@ void lcd_puts_p(const char *progmem_s)
 }/* lcd_puts_p */
 
 
+#if LCD_GLYPH_CACHE
 /*************************************************************************
-Initialize display and select type of cursor 
-Input:    dispAttr LCD_DISP_OFF            display off
-                   LCD_DISP_ON             display on, cursor off
-                   LCD_DISP_ON_CURSOR      display on, cursor on
-                   LCD_DISP_CURSOR_BLINK   display on, cursor on flashing
+Set the glyph library used by lcd_putglyph()
+Input:    progmem_glyphs  glyphs in program memory, 8 bytes each
+          count           number of glyphs
 Returns:  none
 *************************************************************************/
-void lcd_init(uint8_t dispAttr)
+void lcd_glyph_library(const uint8_t *progmem_glyphs, uint8_t count)
+{
+    uint8_t i;
+
+    if ( (progmem_glyphs == glyphLibrary) && (count == glyphCount) )
+        return;                            /* kept over a warm start */
+    glyphLibrary = progmem_glyphs;
+    glyphCount = count;
+    for (i = 0; i < LCD_GLYPH_SLOTS; i++)
+        if (slotGlyph[i] != LCD_GLYPH_BLANK)
+            slotGlyph[i] = LCD_GLYPH_UNKNOWN;
+    glyphCheck = lcd_glyph_sum();
+
+}/* lcd_glyph_library */
+
+
+/*************************************************************************
+Find the CGRAM character holding glyph id, uploading it to the least
+recently used one that is not on the screen if it is not cached, and
+put the address counter back to pos after an upload
+Returns:  the CGRAM character, LCD_GLYPH_SLOTS if all are on the screen
+*************************************************************************/
+static uint8_t lcd_glyph_slot(uint8_t id, uint8_t pos)
+{
+    uint8_t slot, i;
+
+
+    glyphClock++;
+
+    for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++)
+        if (slotGlyph[slot] == id)
+            break;
+
+    if (slot == LCD_GLYPH_SLOTS)
+    {
+        /* not cached, replace the least recently used that is not on the screen */
+        for (i = 0; i < LCD_GLYPH_SLOTS; i++) {
+            if ( slotRefs[i] )
+                continue;
+            if ( (slot == LCD_GLYPH_SLOTS)
+              || ((uint8_t)(glyphClock-slotUsed[i]) > (uint8_t)(glyphClock-slotUsed[slot])) )
+                slot = i;
+        }
+        if (slot == LCD_GLYPH_SLOTS)
+            return slot;
+        lcd_glyph_keep(slotGlyph[slot], id);
+        lcd_command((1<<LCD_CGRAM)+(slot<<3));
+        for (i = 0; i < 8; i++)
+            lcd_data(pgm_read_byte(&glyphLibrary[(id<<3)+i]));
+        lcd_command((1<<LCD_DDRAM)+pos);
+        lcd_waitbusy();
+    }
+
+    slotUsed[slot] = glyphClock;
+    return slot;
+
+}/* lcd_glyph_slot */
+
+
+/*************************************************************************
+Display glyph from the library at current cursor position, uploading it
+to CGRAM first if it is not cached
+Input:    id  glyph number in the library
+Returns:  none
+*************************************************************************/
+void lcd_putglyph(uint8_t id)
+{
+    uint8_t pos, cell, slot;
+
+
+    pos = lcd_waitbusy();   // read busy-flag and address counter
+    cell = lcd_cell_release(pos);
+    if (id >= glyphCount) {
+        lcd_write(' ', 1);
+        return;
+    }
+
+    slot = lcd_glyph_slot(id, pos);
+    if (slot == LCD_GLYPH_SLOTS) {
+        lcd_write(' ', 1);
+        return;
+    }
+
+    if (cell != 0xFF) {
+        slotRefs[slot]++;
+        lcd_glyph_keep(cellSlot[cell], slot+1);
+    }
+    lcd_write(slot, 1);
+
+}/* lcd_putglyph */
+
+
+/*************************************************************************
+Upload a glyph from the library to CGRAM ahead of lcd_putglyph()
+Input:    id  glyph number in the library
+Returns:  1 if the glyph is in CGRAM, 0 if all 8 are on the screen
+*************************************************************************/
+uint8_t lcd_glyph_load(uint8_t id)
+{
+    if (id >= glyphCount)
+        return 0;
+    return lcd_glyph_slot(id, lcd_waitbusy()) != LCD_GLYPH_SLOTS;
+
+}/* lcd_glyph_load */
+#else
+/*************************************************************************
+Without the glyph cache, upload the first 8 glyphs of the library
+*************************************************************************/
+void lcd_glyph_library(const uint8_t *progmem_glyphs, uint8_t count)
+{
+    uint8_t i;
+
+    if (count > LCD_GLYPH_SLOTS)
+        count = LCD_GLYPH_SLOTS;
+    glyphCount = count;
+    lcd_command(1<<LCD_CGRAM);
+    for (i = 0; i < (count<<3); i++)
+        lcd_data(pgm_read_byte(&progmem_glyphs[i]));
+    lcd_command(1<<LCD_DDRAM);
+
+}/* lcd_glyph_library */
+
+
+/*************************************************************************
+Without the glyph cache, glyph n is CGRAM character n
+*************************************************************************/
+void lcd_putglyph(uint8_t id)
+{
+    lcd_putc( (id < glyphCount) ? id : ' ' );
+
+}/* lcd_putglyph */
+
+
+/*************************************************************************
+Without the glyph cache, the first 8 glyphs are always in CGRAM
+*************************************************************************/
+uint8_t lcd_glyph_load(uint8_t id)
+{
+    return id < glyphCount;
+
+}/* lcd_glyph_load */
+#endif
+
+
+/*************************************************************************
+Configure the MCU lines to the LCD
+*************************************************************************/
+static void lcd_port_init(void)
 {
 #if LCD_IO_MODE
-    /*
-     *  Initialize LCD to 4 bit I/O mode
-     */
-     
     if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
+      && !LCD_RW_TIED_LOW
       && ( &LCD_RS_PORT == &LCD_DATA0_PORT) && ( &LCD_RW_PORT == &LCD_DATA0_PORT) && (&LCD_E_PORT == &LCD_DATA0_PORT)
       && (LCD_DATA0_PIN == 0 ) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) 
       && (LCD_RS_PIN == 4 ) && (LCD_RW_PIN == 5) && (LCD_E_PIN == 6 ) )
@@ -522,27 +978,56 @@ void lcd_init(uint8_t dispAttr)
         /* configure all port bits as output (all LCD data lines on same port, but control lines on different ports) */
         DDR(LCD_DATA0_PORT) |= 0x0F;
         DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
+#if !LCD_RW_TIED_LOW
         DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
+#endif
         DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
     }
     else
     {
         /* configure all port bits as output (LCD data and control lines on different ports */
         DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
+#if !LCD_RW_TIED_LOW
         DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
+#endif
         DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
         DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
         DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
         DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
         DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
     }
-    delay(LCD_DELAY_BOOTUP);             /* wait 16ms or more after power-on       */
-    
+#else
+    /* enable external SRAM (memory mapped lcd) and one wait state */        
+#if defined(SRW10)
+    /* ATmega162: the whole external memory is one sector, SRW11:SRW10 set its wait states */
+    MCUCR |= _BV(SRE) | _BV(SRW10);
+#if F_CPU > 8000000
+    EMCUCR |= _BV(SRW11);                  /* keep E high for at least 450ns */
+#endif
+#else
+    MCUCR |= _BV(SRE) | _BV(SRW);
+#endif
+#endif
+}/* lcd_port_init */
+
+
+#if LCD_IO_MODE
+/*************************************************************************
+Put the LCD into 4 bit mode, from 8 bit mode or from 4 bit mode in any
+state, also half way through a byte
+Input:    warm   0: after power-on
+                 1: the LCD has been running, a reset may have cut a write short
+*************************************************************************/
+static void lcd_sync(uint8_t warm)
+{
     /* initial write to lcd is 8bit */
     LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);    // LCD_FUNCTION>>4;
     LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);    // LCD_FUNCTION_8BIT>>4;
     lcd_e_toggle();
-    delay(LCD_DELAY_INIT);               /* delay, busy flag can't be checked here */
+    if (warm)
+        delay(LCD_DELAY_EXEC_LONG);      /* may have ended a clear or home instruction */
+    else
+        delay(LCD_DELAY_INIT);           /* delay, busy flag can't be checked here */
    
     /* repeat last command */ 
     lcd_e_toggle();      
@@ -556,18 +1041,53 @@ void lcd_init(uint8_t dispAttr)
     LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);   // LCD_FUNCTION_4BIT_1LINE>>4
     lcd_e_toggle();
     delay(LCD_DELAY_INIT_4BIT);          /* some displays need this additional delay */
+
+}/* lcd_sync */
+#endif
+
+
+/*************************************************************************
+Send function set for the display lines
+*************************************************************************/
+static void lcd_function_set(void)
+{
+#if KS0073_4LINES_MODE
+    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
+    lcd_command(KS0073_4LINES_MODE);
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
+#else
+    lcd_command(LCD_FUNCTION_DEFAULT);      /* function set: display lines  */
+#endif
+}/* lcd_function_set */
+
+
+/*************************************************************************
+Initialize display and select type of cursor 
+Input:    dispAttr LCD_DISP_OFF            display off
+                   LCD_DISP_ON             display on, cursor off
+                   LCD_DISP_ON_CURSOR      display on, cursor on
+                   LCD_DISP_CURSOR_BLINK   display on, cursor on flashing
+Returns:  none
+*************************************************************************/
+void lcd_init(uint8_t dispAttr)
+{
+    lcd_fault = 0;
+    lcd_port_init();
+    delay(LCD_DELAY_BOOTUP);             /* wait 16ms or more after power-on       */
+#if LCD_IO_MODE
+    /*
+     *  Initialize LCD to 4 bit I/O mode
+     */
+    lcd_sync(0);
     
     /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */    
 #else
     /*
      * Initialize LCD to 8 bit memory mapped mode
      */
-    
-    /* enable external SRAM (memory mapped lcd) and one wait state */        
-    MCUCR = _BV(SRE) | _BV(SRW);
 
     /* reset LCD */
-    delay(LCD_DELAY_BOOTUP);                    /* wait 16ms after power-on     */
     lcd_write(LCD_FUNCTION_8BIT_1LINE,0);   /* function set: 8bit interface */                   
     delay(LCD_DELAY_INIT);                      /* wait 5ms                     */
     lcd_write(LCD_FUNCTION_8BIT_1LINE,0);   /* function set: 8bit interface */                 
@@ -576,17 +1096,71 @@ void lcd_init(uint8_t dispAttr)
     delay(LCD_DELAY_INIT_REP);                  /* wait 64us                    */
 #endif
 
-#if KS0073_4LINES_MODE
-    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
-    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-    lcd_command(KS0073_4LINES_MODE);
-    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-#else
-    lcd_command(LCD_FUNCTION_DEFAULT);      /* function set: display lines  */
-#endif
+    lcd_function_set();
     lcd_command(LCD_DISP_OFF);              /* display off                  */
     lcd_clrscr();                           /* display clear                */ 
     lcd_command(LCD_MODE_DEFAULT);          /* set entry mode               */
     lcd_command(dispAttr);                  /* display/cursor control       */
+#if LCD_GLYPH_CACHE
+    lcd_glyph_reset();                      /* CGRAM is undefined after power-on */
+#endif
 
 }/* lcd_init */
+
+
+/*************************************************************************
+Take over a display that stayed powered while the MCU was reset
+Input:    dispAttr see lcd_init()
+Returns:  1 if the display and glyph cache were taken over
+          0 if it had to be initialized with lcd_init()
+*************************************************************************/
+uint8_t lcd_init_warm(uint8_t dispAttr)
+{
+#if LCD_GLYPH_CACHE && !LCD_RW_TIED_LOW
+    uint8_t slot, i, glyph, expect, checked;
+
+
+    if ( glyphCheck == lcd_glyph_sum() )
+    {
+        lcd_fault = 0;
+        lcd_port_init();
+#if LCD_IO_MODE
+        lcd_sync(1);
+#endif
+        lcd_function_set();
+        lcd_command(LCD_MODE_DEFAULT);
+        lcd_command(dispAttr);
+
+        /* the CGRAM contents are the signature that the display kept its power */
+        checked = 0;
+        for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++) {
+            glyph = slotGlyph[slot];
+            if (glyph == LCD_GLYPH_UNKNOWN)
+                continue;
+            lcd_command((1<<LCD_CGRAM)+(slot<<3));
+            for (i = 0; i < 8; i++) {
+                expect = (glyph == LCD_GLYPH_BLANK) ? 0 : pgm_read_byte(&glyphLibrary[(glyph<<3)+i]);
+                lcd_waitbusy();
+                if ( (lcd_read(1) & 0x1F) != expect )
+                    break;
+            }
+            if (i < 8)
+                break;
+            checked++;
+        }
+
+        if ( (slot == LCD_GLYPH_SLOTS) && checked ) {
+            lcd_command(1<<LCD_DDRAM);
+            for (slot = 0; slot < LCD_GLYPH_SLOTS; slot++)
+                slotRefs[slot] = 0;
+            for (i = 0; i < LCD_LINES*LCD_DISP_LENGTH; i++)
+                if (cellSlot[i])
+                    slotRefs[cellSlot[i]-1]++;
+            return 1;
+        }
+    }
+#endif
+    lcd_init(dispAttr);
+    return 0;
+
+}/* lcd_init_warm */
@@ -103,6 +103,23 @@
 #ifndef LCD_WRAP_LINES
 #define LCD_WRAP_LINES      0     /**< 0: no wrap, 1: wrap at end of visibile line */
 #endif
+#ifndef LCD_STATS
+#define LCD_STATS           1     /**< 0: no counters, 1: count bytes written and busy flag reads */
+#endif
+#ifndef LCD_RW_TIED_LOW
+#define LCD_RW_TIED_LOW     0     /**< 0: read the busy flag, 1: R/W tied low, wait instruction execution times */
+#endif
+
+
+/**
+ * @name  Definitions for the glyph cache
+ * With LCD_GLYPH_CACHE set the 8 CGRAM characters are used as a cache
+ * over a larger library of glyphs in program memory, see lcd_putglyph().
+ */
+#ifndef LCD_GLYPH_CACHE
+#define LCD_GLYPH_CACHE     1     /**< 0: no glyph cache, 1: glyph cache */
+#endif
+#define LCD_GLYPH_SLOTS     8     /**< number of CGRAM characters        */
 
 
 /**
@@ -123,7 +140,9 @@
  * All definitions added to the file lcd_definitions.h will override the default definitions from lcd.h
  *  
  */
+#ifndef LCD_IO_MODE
 #define LCD_IO_MODE      1            /**< 0: memory mapped mode, 1: IO port mode */
+#endif
 
 #if LCD_IO_MODE
 
@@ -217,6 +236,15 @@
 #ifndef LCD_DELAY_ENABLE_PULSE
 #define LCD_DELAY_ENABLE_PULSE 1      /**< enable signal pulse width in micro seconds */
 #endif
+#ifndef LCD_BUSY_LOOPS
+#define LCD_BUSY_LOOPS (F_CPU/1000)   /**< busy flag reads before giving up, each takes 8 cycles or more, so at least 8ms */
+#endif
+#ifndef LCD_DELAY_EXEC
+#define LCD_DELAY_EXEC        37      /**< execution time in micro seconds of data writes and most instructions, with LCD_RW_TIED_LOW */
+#endif
+#ifndef LCD_DELAY_EXEC_LONG
+#define LCD_DELAY_EXEC_LONG 1520      /**< execution time in micro seconds of clear display and return home */
+#endif
 
 
 /**
@@ -359,6 +387,94 @@ extern void lcd_command(uint8_t cmd);
 extern void lcd_data(uint8_t data);
 
 
+/**
+ @brief    Check that the busy flag and address counter can be read back
+ 
+ Clears the display, checks that the busy flag is set while the clear
+ runs, then moves the cursor and reads the address counter back.
+ Useful to check the wiring of the R/W line, especially through the
+ external memory interface in memory mapped mode.
+ With LCD_RW_TIED_LOW nothing can be read, only the display is cleared.
+ @return   1 if the LCD answered as expected, 0 if not
+*/
+extern uint8_t lcd_probe(void);
+
+
+#if LCD_STATS
+/**
+ @brief    Bytes written to the LCD and busy flag reads while waiting, counted
+           with LCD_STATS until the caller resets them
+*/
+extern uint16_t lcd_bytes;
+extern uint16_t lcd_spins;
+#endif
+
+
+/**
+ @brief    Set when the LCD did not clear its busy flag within LCD_BUSY_LOOPS reads
+ 
+ The display is then taken to be missing and the library no longer waits
+ for it.  Cleared by lcd_init().
+*/
+extern uint8_t lcd_fault;
+
+
+/**
+ @brief    Set the glyph library used by lcd_putglyph()
+ 
+ Forgets what is cached in CGRAM, unless it is the library that was in
+ use before a warm start.  Without LCD_GLYPH_CACHE the first 8 glyphs
+ are uploaded to CGRAM here.
+ @param    progmem_glyphs glyphs in program memory, 8 bytes each as written to CGRAM
+ @param    count number of glyphs
+ @return   none
+*/
+extern void lcd_glyph_library(const uint8_t *progmem_glyphs, uint8_t count);
+
+
+/**
+ @brief    Display glyph from the library at current cursor position
+ 
+ The glyph is uploaded to a CGRAM character if it is not in one already.
+ The library keeps count of how many cells on the screen show each CGRAM
+ character and only reuses one that is not on the screen, the least
+ recently used.  If all 8 are on the screen a space is displayed instead.
+ Use only lcd_putglyph() for custom characters while the cache is in use,
+ characters 0-7 written with lcd_putc() are not counted.
+ Without LCD_GLYPH_CACHE glyphs past the first 8 are displayed as a space.
+ @param    id glyph number in the library
+ @return   none
+*/
+extern void lcd_putglyph(uint8_t id);
+
+
+/**
+ @brief    Upload a glyph from the library to CGRAM ahead of lcd_putglyph()
+ 
+ Glyphs are only uploaded to CGRAM characters that are not on the
+ screen, so a frame of an animation can be loaded while the one before
+ is still shown, and then be written to the screen in one go.  A glyph
+ loaded but not displayed may be replaced by the next one loaded when
+ no other CGRAM character is free.
+ @param    id glyph number in the library
+ @return   1 if the glyph is in CGRAM, 0 if all 8 are on the screen
+*/
+extern uint8_t lcd_glyph_load(uint8_t id);
+
+
+/**
+ @brief    Initialize a display that stayed powered while the MCU was reset
+ 
+ Skips the power-on delays and keeps the screen and the glyph cache, if
+ the glyph cache state survived the reset and what is in CGRAM reads
+ back as expected.  Otherwise does lcd_init().  Always does lcd_init()
+ without LCD_GLYPH_CACHE or with LCD_RW_TIED_LOW.
+ @param    dispAttr see lcd_init()
+ @return   1 if the display was taken over, 0 if it was initialized
+*/
+extern uint8_t lcd_init_warm(uint8_t dispAttr);
+
+
 /**
  @brief macros for automatically storing string constant in program memory
 */
@@ -0,0 +1,85 @@
+// Title:    Marquee
+// File:     marquee.c
+//
+
+#include <string.h>
+#include "lcd.h"
+#include "marquee.h"
+
+#if LCD_LINES == 2
+
+// the line scrolled, and how far the screen is shifted along it
+static uint8_t scrolled;
+static uint8_t shift;
+// what each DDRAM line holds, by line number
+static char ddram[2][MARQUEE_LENGTH];
+// what the line that stays put shows
+static char fixed[LCD_DISP_LENGTH];
+// the DDRAM address the next character goes to, 0xFF if not known
+static uint8_t cursor;
+
+// Write c at address of DDRAM line, unless it is there already.
+static void marquee_put(uint8_t line, uint8_t address, char c)
+{
+    uint8_t to = (line ? LCD_START_LINE2 : LCD_START_LINE1) + address;
+
+    if (ddram[line][address] == c)
+        return;
+    if (to != cursor)
+        lcd_command((1<<LCD_DDRAM) + to);
+    lcd_putc(c);
+    ddram[line][address] = c;
+    cursor = to + 1;
+}
+
+// Write the line that stays put where the shifted screen shows it.
+static void marquee_compensate(void)
+{
+    uint8_t address = shift;
+    uint8_t n;
+
+    cursor = 0xFF;
+    for (n = 0; n < LCD_DISP_LENGTH; n++) {
+        marquee_put(!scrolled, address, fixed[n]);
+        if (++address == MARQUEE_LENGTH)
+            address = 0;
+    }
+}
+
+void marquee_start(uint8_t line)
+{
+    // clearing also takes the shift back
+    lcd_clrscr();
+    scrolled = line;
+    shift = 0;
+    memset(ddram, ' ', sizeof(ddram));
+    memset(fixed, ' ', sizeof(fixed));
+}
+
+void marquee_text(const char *text)
+{
+    uint8_t n;
+
+    cursor = 0xFF;
+    for (n = 0; n < MARQUEE_LENGTH; n++)
+        marquee_put(scrolled, n, *text ? *text++ : ' ');
+}
+
+void marquee_fixed(const char *text)
+{
+    uint8_t n;
+
+    for (n = 0; n < LCD_DISP_LENGTH; n++)
+        fixed[n] = *text ? *text++ : ' ';
+    marquee_compensate();
+}
+
+void marquee_step(void)
+{
+    lcd_command(LCD_MOVE_DISP_LEFT);
+    if (++shift == MARQUEE_LENGTH)
+        shift = 0;
+    marquee_compensate();
+}
+
+#endif
@@ -0,0 +1,41 @@
+// Title:    Marquee
+// File:     marquee.h
+//
+// Scrolls one line of a two line display with the HD44780's display
+// shift.  Each line of DDRAM holds MARQUEE_LENGTH characters, of which
+// the screen shows the first LCD_DISP_LENGTH; the whole text goes into
+// the line once and each step is then one shift command.  The shift
+// moves both lines, so the other line is written again at the shifted
+// addresses.  Only the characters that differ from what DDRAM holds
+// there are written, a few for a time in the middle of blanks.
+//
+// The text is plain characters, no glyphs: the glyph cache does not
+// know which addresses the shift brings onto the screen.  Only for two
+// line displays, on four line ones the shift moves lines 1 and 3 as one
+// and lines 2 and 4 as another.
+//
+
+#ifndef MARQUEE_H
+#define MARQUEE_H
+
+#include <inttypes.h>
+
+// characters a DDRAM line holds in two line mode, the shift wraps there
+#define MARQUEE_LENGTH 40
+
+// Clear the screen and scroll line (0 or 1) from now on, the other one
+// stays put.
+void marquee_start(uint8_t line);
+
+// Set the text scrolled, up to MARQUEE_LENGTH characters, padded with
+// spaces.
+void marquee_text(const char *text);
+
+// Set the text of the line that stays put, up to LCD_DISP_LENGTH
+// characters, padded with spaces.
+void marquee_fixed(const char *text);
+
+// Scroll one character to the left.
+void marquee_step(void);
+
+#endif // MARQUEE_H
@@ -0,0 +1,193 @@
+// Title:    Clock state persistence
+// File:     persist.c
+//
+// The EEPROM is rated for 100,000 write cycles per cell.  Spreading the
+// checkpoints over EEMAP_PERSIST_SLOTS slots divides the wear on each
+// cell by the number of slots; with 16 slots and one checkpoint every
+// 15 minutes each cell is written 6 times a day, which is good for
+// more than 40 years.
+//
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+#include "eemap.h"
+#include "persist.h"
+
+struct persist_slot {
+    uint16_t seq;
+    struct persist_record record;
+    uint8_t crc;
+};
+
+struct persist_lastgasp {
+    uint8_t seq;            // low byte of the checkpoint sequence number
+    uint16_t age;
+    uint8_t crc;
+};
+
+typedef char persist_slot_size_check
+    [sizeof(struct persist_slot) == EEMAP_PERSIST_SLOT_SIZE ? 1 : -1];
+
+#define SLOT_OFFSET(n)  (EEMAP_PERSIST_RING + (n) * EEMAP_PERSIST_SLOT_SIZE)
+#define SLOT_ADDRESS(n) ((uint8_t *)SLOT_OFFSET(n))
+
+// erased EEPROM reads back as 0xFF, never use that as a sequence number
+#define SEQ_ERASED 0xFFFF
+
+volatile uint16_t persist_age;
+
+static struct persist_slot staging;
+static uint16_t restored_seq;
+static uint16_t next_seq;
+static uint8_t next_slot;
+static volatile uint16_t write_address;
+static volatile uint8_t write_index = sizeof(struct persist_slot);
+
+static uint8_t block_crc(const void *block, uint8_t length)
+{
+    const uint8_t *p = (const uint8_t *)block;
+    uint8_t crc = 0;
+
+    while (length--)
+        crc = _crc8_ccitt_update(crc, *p++);
+    return crc;
+}
+
+#define slot_crc(slot) block_crc(slot, offsetof(struct persist_slot, crc))
+#define lastgasp_crc(lg) block_crc(lg, offsetof(struct persist_lastgasp, crc))
+
+// true if sequence number a was written after b, allowing for wrap
+static uint8_t seq_newer(uint16_t a, uint16_t b)
+{
+    return (int16_t)(a - b) > 0;
+}
+
+uint8_t persist_restore(struct persist_record *record)
+{
+    uint16_t seq[EEMAP_PERSIST_SLOTS];
+    uint8_t n, newest;
+
+    // Only the sequence numbers are read for the search, the full slot
+    // is read and checked just for the candidate.
+    for (n = 0; n < EEMAP_PERSIST_SLOTS; n++)
+        seq[n] = eeprom_read_word((const uint16_t *)SLOT_ADDRESS(n));
+
+    for (;;) {
+        newest = EEMAP_PERSIST_SLOTS;
+        for (n = 0; n < EEMAP_PERSIST_SLOTS; n++) {
+            if (seq[n] == SEQ_ERASED)
+                continue;
+            if (newest == EEMAP_PERSIST_SLOTS || seq_newer(seq[n], seq[newest]))
+                newest = n;
+        }
+        if (newest == EEMAP_PERSIST_SLOTS)
+            return 0;
+
+        eeprom_read_block(&staging, SLOT_ADDRESS(newest), sizeof(staging));
+        if (staging.seq == seq[newest] && staging.crc == slot_crc(&staging))
+            break;
+        // torn or corrupted slot, try the next newest one
+        seq[newest] = SEQ_ERASED;
+    }
+
+    *record = staging.record;
+    restored_seq = staging.seq;
+    next_seq = staging.seq + 1;
+    next_slot = (newest + 1) % EEMAP_PERSIST_SLOTS;
+    return 1;
+}
+
+uint8_t persist_busy(void)
+{
+    return write_index < sizeof(struct persist_slot);
+}
+
+uint8_t persist_save(const struct persist_record *record)
+{
+    if (persist_busy())
+        return 0;
+
+    if (next_seq == SEQ_ERASED)
+        next_seq = 0;
+    staging.seq = next_seq++;
+    staging.record = *record;
+    staging.crc = slot_crc(&staging);
+
+    write_address = SLOT_OFFSET(next_slot);
+    next_slot = (next_slot + 1) % EEMAP_PERSIST_SLOTS;
+    write_index = 0;
+    // EE_RDY fires as soon as the EEPROM is idle and starts the write
+    EECR |= _BV(EERIE);
+    return 1;
+}
+
+uint16_t persist_lastgasp_age(void)
+{
+    struct persist_lastgasp lg;
+
+    eeprom_read_block(&lg, (const void *)EEMAP_LASTGASP, sizeof(lg));
+    if ((lg.crc != lastgasp_crc(&lg)) || (lg.seq != (uint8_t)restored_seq))
+        return 0;
+    eeprom_write_byte((uint8_t *)EEMAP_LASTGASP +
+            offsetof(struct persist_lastgasp, crc), ~lg.crc);
+    return lg.age;
+}
+
+//
+// Runs from the power fail interrupt with the supply capacitor as the
+// only energy left, so it does the minimum: finish the EEPROM byte in
+// flight, then write four bytes.  If a checkpoint was half written the
+// record is tagged with that checkpoint's sequence number; it then
+// fails to match on restore and the previous checkpoint is used as is.
+//
+// The interrupt can also land inside an eeprom_*() call of the main
+// loop, alarm.c's say, after it loaded EEAR and EEDR and before it
+// strobed EEWE or read EEDR.  Those are put back, once the last byte
+// here is written, for it to carry on with.
+//
+void persist_lastgasp(void)
+{
+    struct persist_lastgasp lg;
+    uint8_t *p = (uint8_t *)&lg;
+    uint16_t address = EEAR;
+    uint8_t data = EEDR;
+    uint8_t n;
+
+    EECR &= ~_BV(EERIE);
+    write_index = sizeof(struct persist_slot);
+
+    lg.seq = (uint8_t)staging.seq;
+    lg.age = persist_age;
+    lg.crc = lastgasp_crc(&lg);
+    for (n = 0; n < sizeof(lg); n++)
+        eeprom_write_byte((uint8_t *)EEMAP_LASTGASP + n, p[n]);
+    eeprom_busy_wait();
+    EEAR = address;
+    EEDR = data;
+}
+
+//
+// One byte per interrupt.  Bytes that already hold the right value are
+// skipped, which saves both time and wear as most of a checkpoint is
+// the same as the one written to that slot last time round the ring.
+//
+ISR(EE_RDY_vect)
+{
+    uint8_t *p = (uint8_t *)&staging;
+
+    while (write_index < sizeof(struct persist_slot)) {
+        EEAR = write_address + write_index;
+        EECR |= _BV(EERE);
+        if (EEDR != p[write_index]) {
+            EEDR = p[write_index++];
+            EECR |= _BV(EEMWE);
+            EECR |= _BV(EEWE);
+            return;
+        }
+        write_index++;
+    }
+    EECR &= ~_BV(EERIE);
+}
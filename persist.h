@@ -0,0 +1,58 @@
+// Title:    Clock state persistence
+// File:     persist.h
+//
+// Checkpoints of the clock state are written to a ring of EEPROM slots.
+// Each slot carries a sequence number and a CRC, so on boot the newest
+// slot that is intact can be found and restored.  Writes are done one
+// byte per EE_RDY interrupt and never block the caller.
+//
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <inttypes.h>
+
+// What gets saved.  Must fit in a slot together with the sequence
+// number (2 bytes) and the CRC (1 byte).
+struct persist_record {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t dst_active;
+    uint8_t mode;           // display mode selected by the user
+    uint8_t spare[4];
+};
+
+// Find the newest valid slot and copy it to record.  Returns non-zero
+// if one was found, zero if the EEPROM holds no valid checkpoint.  The
+// next checkpoint goes in the slot after it, so this must be called
+// once on boot before persist_save(), whether or not record is used.
+uint8_t persist_restore(struct persist_record *record);
+
+// Start writing record to the next slot of the ring.  Returns zero
+// without doing anything if the previous write is still in progress.
+uint8_t persist_save(const struct persist_record *record);
+
+// Return non-zero while a checkpoint is being written.
+uint8_t persist_busy(void);
+
+// Seconds since the last checkpoint was taken.  Incremented once a
+// second by the clock, cleared when the clock takes a snapshot.
+extern volatile uint16_t persist_age;
+
+// Called when the supply is failing.  Abandons any checkpoint being
+// written and saves just persist_age tagged with the sequence number of
+// the checkpoint it counts from.  Busy-waits on the EEPROM, at most
+// five byte writes.
+void persist_lastgasp(void);
+
+// After persist_restore(), return the number of seconds the clock ran
+// past the restored checkpoint before the power failed, or zero if no
+// last gasp record belongs to that checkpoint.  The record is
+// invalidated so it is only applied once.
+uint16_t persist_lastgasp_age(void);
+
+#endif // PERSIST_H
@@ -0,0 +1,148 @@
+// Title:    Power management
+// File:     power.c
+//
+
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "sched.h"
+#include "power.h"
+
+// Crystal cycles from reading TCNT1 to the new clock running, on
+// average: the two reads and two stores of power_clkpr() and the rest
+// of T1 at the old speed, and one and a half periods of the new.
+#define POWER_LAG(from, to) ((6 << (from)) + ((3 << (to)) >> 1))
+// The same in timer counts, which follow the CPU clock: six at the old
+// speed and one and a half at the new
+#define POWER_LAG_COUNTS 7
+// Fewest crystal cycles left of a tick after a change, enough to set
+// OCR1A before the timer gets there
+#define POWER_MARGIN 256
+
+volatile uint8_t power_bursts = 1;
+volatile uint8_t power_shift;
+volatile uint8_t power_retop;
+volatile uint8_t power_fast;
+
+#if POWER_POLICY == 2
+// crystal cycles owed to the ticks after the last change, less than a
+// slow count, or less than zero if a tick had to be made longer
+static int16_t power_residue;
+// crystal cycles of the tick in progress before the last change of
+// speed in it, and the timer count then
+uint16_t power_base;
+uint16_t power_base_count;
+
+// Read TCNT1 and write CLKPR straight after it, so the timer count at
+// the switch is known to a cycle or two.
+static inline uint16_t power_clkpr(uint8_t value)
+{
+    uint16_t count;
+
+    __asm__ __volatile__ (
+        "in %A0, %1" "\n\t"
+        "in %B0, %2" "\n\t"
+        "sts %3, %4" "\n\t"
+        "sts %3, %5" "\n\t"
+        : "=&r" (count)
+        : "I" (_SFR_IO_ADDR(TCNT1L)), "I" (_SFR_IO_ADDR(TCNT1H)),
+          "n" (_SFR_MEM_ADDR(CLKPR)), "r" ((uint8_t)_BV(CLKPCE)),
+          "r" (value));
+    return count;
+}
+
+// Change the clock to F_CPU >> shift, keeping the tick in progress on
+// time.  Interrupts are off.
+static void power_change(uint8_t shift)
+{
+    uint8_t from = power_shift;
+    uint8_t started;
+    uint16_t count;
+    uint32_t elapsed;
+    int32_t left;
+
+    // out of the timer's reach while the speed changes; a tick that
+    // ended before that has not had its interrupt yet
+    OCR1A = 0xFFFF;
+    started = bit_is_set(TIFR, OCF1A);
+    if (started) {
+        power_base = 0;
+        power_base_count = 0;
+    }
+    count = power_clkpr(shift);
+    power_shift = shift;
+
+    elapsed = power_base + ((uint32_t)(count - power_base_count) << from) +
+        POWER_LAG(from, shift);
+    count += POWER_LAG_COUNTS;
+    power_base = elapsed;
+    power_base_count = count;
+    left = (int32_t)POWER_TICK_CYCLES + power_residue - elapsed;
+    if (left < POWER_MARGIN) {
+        // too late to end this tick on time, the next change makes
+        // it up
+        power_residue = left - POWER_MARGIN;
+        left = POWER_MARGIN;
+    } else {
+        power_residue = left & ((1 << shift) - 1);
+        left -= power_residue;
+    }
+    OCR1A = count + (left >> shift) - 1;
+    // the next interrupt puts the steady top back, unless it is the
+    // late one for this tick
+    power_retop = started ? 2 : 1;
+}
+
+// Called from the timer interrupt at the start of a tick.
+void power_tick_start(void)
+{
+    if (power_retop && !--power_retop) {
+        OCR1A = (POWER_TICK_CYCLES >> power_shift) - 1;
+        power_base = 0;
+        power_base_count = 0;
+    }
+    if (!power_bursts && !power_shift)
+        power_change(POWER_SLOW_SHIFT);
+}
+#endif
+
+void power_init(void)
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+}
+
+void power_burst(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+#if POWER_POLICY == 2
+        if (!power_bursts && power_shift)
+            power_change(0);
+#endif
+        power_bursts++;
+    }
+}
+
+void power_burst_end(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        power_bursts--;
+    }
+}
+
+void power_idle(void)
+{
+#if POWER_POLICY
+    // an interrupt after sei() wakes the sleep right after it
+    cli();
+    if (!sched_due()) {
+        sleep_enable();
+        sei();
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+#endif
+}
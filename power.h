@@ -0,0 +1,91 @@
+// Title:    Power management
+// File:     power.h
+//
+// The main loop sleeps in idle mode until the next tick.  With
+// POWER_POLICY 2 the CPU also runs from the crystal divided by
+// 1 << POWER_SLOW_SHIFT through the system clock prescaler, CLKPR,
+// except in bursts of work that need full speed: LCD updates, whose
+// delays are timed for F_CPU, I2C transfers, whose bit delays are, and
+// USART traffic, whose baud rate is.
+// Bursts nest; the clock goes fast when the first starts and slow at
+// the first tick after the last ends.
+//
+// Timer1 counts the CPU clock, so a change of speed changes how long
+// its counts are.  The tick in progress is kept F_CPU / SCHED_HZ
+// crystal cycles long by setting OCR1A for what is left of it at the
+// new speed, and the cycles that don't make a whole count are carried
+// to the next change.  The prescaler takes between T1 + T2 and
+// T1 + 2 * T2 to switch, so a change can be out by half a period of the
+// slower clock either way, on average nothing.
+//
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <inttypes.h>
+#include <avr/io.h>
+#include "sched.h"
+
+#ifndef POWER_POLICY
+#define POWER_POLICY 2      // 0: full speed, 1: idle sleep, 2: and slow clock
+#endif
+#ifndef POWER_SLOW_SHIFT
+#define POWER_SLOW_SHIFT 3  // slow clock F_CPU / 8
+#endif
+
+// crystal cycles in a tick
+#define POWER_TICK_CYCLES (F_CPU / SCHED_HZ)
+
+#if POWER_TICK_CYCLES % (1 << POWER_SLOW_SHIFT)
+#error "a tick must be a whole number of slow timer counts"
+#endif
+
+extern volatile uint8_t power_bursts;
+extern volatile uint8_t power_shift;
+extern volatile uint8_t power_retop;
+// ticks at full speed, counted up to diag_second()
+extern volatile uint8_t power_fast;
+#if POWER_POLICY == 2
+extern uint16_t power_base;
+extern uint16_t power_base_count;
+#endif
+
+void power_tick_start(void);
+
+// Call at the start of the timer interrupt.  Puts the timer top back
+// after a tick that was cut to fit a change of speed, and slows the
+// clock down once no burst holds it.
+static inline void power_tick(void)
+{
+    if (!power_shift)
+        power_fast++;
+#if POWER_POLICY == 2
+    if (power_retop || !(power_bursts || power_shift))
+        power_tick_start();
+#endif
+}
+
+// Crystal cycles since the tick in progress started, from a TCNT1 read
+// in it, whatever speed the CPU ran at.  Interrupts are off.
+static inline uint16_t power_cycles(uint16_t count)
+{
+#if POWER_POLICY == 2
+    return power_base + ((count - power_base_count) << power_shift);
+#else
+    return count;
+#endif
+}
+
+// Set up the sleep mode.
+void power_init(void);
+
+// Run at full speed until power_burst_end().  The clock starts in a
+// burst that main() ends when it is done setting up.
+void power_burst(void);
+void power_burst_end(void);
+
+// Sleep until the next interrupt, unless a tick is waiting for
+// sched_run().  Call from the main loop.
+void power_idle(void);
+
+#endif // POWER_H
@@ -0,0 +1,67 @@
+// Title:    Power fail detection
+// File:     powerfail.c
+//
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include "persist.h"
+#include "powerfail.h"
+
+#if POWERFAIL_ENABLE
+
+static volatile uint8_t tripped;
+
+void powerfail_init(void)
+{
+    // AIN1 input, no pullup
+    DDRB &= ~_BV(PB3);
+    PORTB &= ~_BV(PB3);
+    // Bandgap on the positive input, interrupt on the rising edge of
+    // ACO, that is when AIN1 falls below the bandgap voltage.  ACIE is
+    // set last, changing ACIS with it set can trigger an interrupt.
+    ACSR = _BV(ACBG) | _BV(ACIS1) | _BV(ACIS0);
+    ACSR |= _BV(ACI);
+    ACSR |= _BV(ACIE);
+}
+
+void powerfail_poll(void)
+{
+    if (tripped && !(ACSR & _BV(ACO))) {
+        tripped = 0;
+        ACSR |= _BV(ACI);
+        ACSR |= _BV(ACIE);
+    }
+}
+
+//
+// Interrupts are turned back on once the comparator interrupt is off,
+// so the timer keeps ticking while this waits on the EEPROM.  If the
+// supply recovers the clock carries on without losing time.
+//
+// The worst case from the comparator tripping to the last EEPROM byte
+// being written, calculated and not measured.  Tee is an EEPROM byte
+// write, 8.5 ms typical and timed by the EEPROM's own oscillator
+// whatever the CPU clock; Tisr is the longest timer interrupt, ISR max
+// on the diagnostics screen, in crystal cycles.  The other cycles are
+// of the CPU clock, which between power bursts is
+// F_CPU >> POWER_SLOW_SHIFT:
+//
+//     Tisr + 500 cycles   before this runs: a timer interrupt, the
+//                         EE_RDY interrupt and an ATOMIC_BLOCK
+//     5 * Tee             a checkpoint byte already being written and
+//                         the four bytes of the last gasp record
+//     4 * Tisr            a tick falling between each pair of writes
+//     300 cycles          this and persist_lastgasp()'s own code
+//
+// Taking Tisr as 8000 crystal cycles, 2 ms, that is 3 + 42.5 + 8 + 0.6,
+// or about 54 ms, which powerfail.h sizes the capacitor for.
+//
+ISR(ANA_COMP_vect)
+{
+    ACSR &= ~_BV(ACIE);
+    tripped = 1;
+    sei();
+    persist_lastgasp();
+}
+
+#endif
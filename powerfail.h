@@ -0,0 +1,44 @@
+// Title:    Power fail detection
+// File:     powerfail.h
+//
+// The analog comparator watches the unregulated supply through a
+// divider on AIN1 (PB3) against the internal bandgap reference.  When
+// the supply drops below the threshold the comparator interrupt saves
+// the clock with persist_lastgasp() while the regulator input
+// capacitor still holds the MCU up.
+//
+// Pick the divider so that AIN1 crosses the bandgap voltage while the
+// regulator still has headroom, and size the capacitor for the hold-up
+// time t = C * dV / I.  The last gasp needs at most five EEPROM byte
+// writes of 8.5 ms each and the timer interrupts between them, about
+// 54 ms as worked out in powerfail.c, so with 10 mA drawn and 2 V of
+// headroom 470 uF is enough with margin.
+//
+// Leave POWERFAIL_ENABLE at 0 unless the divider is fitted: a floating
+// AIN1 triggers spurious last gasps and wears out the EEPROM.
+//
+
+#ifndef POWERFAIL_H
+#define POWERFAIL_H
+
+#ifndef POWERFAIL_ENABLE
+#define POWERFAIL_ENABLE 0
+#endif
+
+#if POWERFAIL_ENABLE
+
+// Configure the comparator and arm the power fail interrupt.
+void powerfail_init(void);
+
+// Re-arm the interrupt once the supply has recovered from a dip that
+// did not reset the MCU.  Call from the main loop.
+void powerfail_poll(void);
+
+#else
+
+static inline void powerfail_init(void) {}
+static inline void powerfail_poll(void) {}
+
+#endif
+
+#endif // POWERFAIL_H
@@ -0,0 +1,22 @@
+// Title:    Reset cause
+// File:     reset.c
+//
+
+#include <avr/io.h>
+#include <avr/wdt.h>
+#include "reset.h"
+
+uint8_t reset_flags __attribute__((section(".noinit")));
+
+// Runs from the startup code, before .data and .bss are set up.  The
+// flags are cleared so that the next reset shows only its own cause,
+// and the watchdog, which stays on through a watchdog reset, is stopped
+// before it fires again.
+void reset_capture(void) __attribute__((naked, used, section(".init3")));
+
+void reset_capture(void)
+{
+    reset_flags = MCUCSR;
+    MCUCSR = 0;
+    wdt_disable();
+}
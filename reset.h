@@ -0,0 +1,22 @@
+// Title:    Reset cause
+// File:     reset.h
+//
+
+#ifndef RESET_H
+#define RESET_H
+
+#include <stdint.h>
+#include <avr/io.h>
+
+// MCUCSR as it was at reset, before anything cleared it.  All zero
+// after a jump to the reset vector.
+extern uint8_t reset_flags;
+
+// Non-zero after a power-on or brown-out reset, when nothing outside
+// the MCU can be assumed to have kept its state.
+static inline uint8_t reset_power_on(void)
+{
+    return reset_flags & (_BV(PORF) | _BV(BORF));
+}
+
+#endif // RESET_H
@@ -0,0 +1,126 @@
+// Title:    DS3231 real time clock
+// File:     rtc.c
+//
+
+#include "i2c.h"
+#include "rtc.h"
+
+#if RTC_ENABLE
+
+#define RTC_REG_SECONDS 0x00
+#define RTC_REG_STATUS  0x0F    // DS323x only
+#define RTC_OSF         7       // oscillator stopped, time not valid
+#define RTC_CH          7       // DS1307 clock halted, in the seconds
+#define RTC_CENTURY     7       // century bit in the month register
+
+static uint8_t bcd_to_bin(uint8_t bcd)
+{
+    return (bcd >> 4) * 10 + (bcd & 0x0F);
+}
+
+static uint8_t bin_to_bcd(uint8_t bin)
+{
+    return ((bin / 10) << 4) | (bin % 10);
+}
+
+// point the register pointer at reg and restart for reading
+static uint8_t rtc_select(uint8_t reg)
+{
+    if (!i2c_start(RTC_ADDRESS, I2C_WRITE) || !i2c_write(reg) ||
+            !i2c_start(RTC_ADDRESS, I2C_READ)) {
+        i2c_stop();
+        return 0;
+    }
+    return 1;
+}
+
+static uint8_t rtc_read(struct clock_time *time)
+{
+    uint8_t reg[7];
+    uint8_t n;
+
+#if !RTC_DS1307
+    if (!rtc_select(RTC_REG_STATUS))
+        return 0;
+    n = i2c_read(0);
+    i2c_stop();
+    if (n & _BV(RTC_OSF))
+        return 0;
+#endif
+
+    if (!rtc_select(RTC_REG_SECONDS))
+        return 0;
+    for (n = 0; n < 7; n++)
+        reg[n] = i2c_read(n < 6);
+    i2c_stop();
+#if RTC_DS1307
+    if (reg[0] & _BV(RTC_CH))
+        return 0;
+#endif
+
+    time->second = bcd_to_bin(reg[0] & 0x7F);
+    time->minute = bcd_to_bin(reg[1] & 0x7F);
+    time->hour = bcd_to_bin(reg[2] & 0x3F);     // always written 24 hour
+    time->day = bcd_to_bin(reg[4] & 0x3F);
+    time->month = bcd_to_bin(reg[5] & 0x1F);
+    time->year = 2000 + bcd_to_bin(reg[6]);
+    if (reg[5] & _BV(RTC_CENTURY))
+        time->year += 100;
+    // what a failing battery or a glitch on the bus leaves is not a time
+    return time->second <= 59 && time->minute <= 59 && time->hour <= 23 &&
+        time->day >= 1 && time->day <= 31 &&
+        time->month >= 1 && time->month <= 12 &&
+        time->year >= 2020 && time->year <= 2119;
+}
+
+static uint8_t rtc_write(const struct clock_time *time)
+{
+    uint8_t century = 0;
+    uint8_t year = time->year - 2000;
+    uint8_t ok;
+#if !RTC_DS1307
+    uint8_t status;
+#endif
+
+    if (year > 99) {
+        year -= 100;
+        century = _BV(RTC_CENTURY);
+    }
+    // Writing the seconds register restarts the RTC's one second
+    // countdown, so the RTC and the clock tick in step afterwards.  On
+    // the DS1307 it also clears the clock halt bit, and the century bit
+    // is lost.
+    ok = i2c_start(RTC_ADDRESS, I2C_WRITE) &&
+        i2c_write(RTC_REG_SECONDS) &&
+        i2c_write(bin_to_bcd(time->second)) &&
+        i2c_write(bin_to_bcd(time->minute)) &&
+        i2c_write(bin_to_bcd(time->hour)) &&
+        i2c_write(1) &&                     // weekday, not used
+        i2c_write(bin_to_bcd(time->day)) &&
+        i2c_write(bin_to_bcd(time->month) | century) &&
+        i2c_write(bin_to_bcd(year));
+    i2c_stop();
+#if !RTC_DS1307
+    if (!ok)
+        return 0;
+
+    // Clear the oscillator stop flag, the time is valid now.  The rest
+    // of the register, the 32 kHz output enable, stays as it is.
+    if (!rtc_select(RTC_REG_STATUS))
+        return 0;
+    status = i2c_read(0);
+    i2c_stop();
+    ok = i2c_start(RTC_ADDRESS, I2C_WRITE) &&
+        i2c_write(RTC_REG_STATUS) &&
+        i2c_write(status & ~_BV(RTC_OSF));
+    i2c_stop();
+#endif
+    return ok;
+}
+
+const struct clock_source rtc_clock_source = {
+    rtc_read,
+    rtc_write,
+};
+
+#endif
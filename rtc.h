@@ -0,0 +1,33 @@
+// Title:    DS3231 real time clock
+// File:     rtc.h
+//
+// Battery backed RTC on the software I2C bus.  Also works with the
+// DS3232, and with the DS1307 when built with RTC_DS1307 set to 1.  The
+// DS1307 shares the time registers but has no status register, where
+// the DS323x keep the oscillator stop flag; its NVRAM is at that
+// address instead, so the clock halt bit in the seconds register is
+// checked in its place.  The DS1307 has no century bit either, so it
+// only keeps years up to 2099.
+//
+// Leave RTC_ENABLE at 0 if no RTC is fitted.
+//
+
+#ifndef RTC_H
+#define RTC_H
+
+#include "clocksource.h"
+
+#ifndef RTC_ENABLE
+#define RTC_ENABLE 0
+#endif
+
+#ifndef RTC_DS1307
+#define RTC_DS1307 0
+#endif
+
+#define RTC_ADDRESS 0x68
+
+// Clock source backed by the RTC.
+extern const struct clock_source rtc_clock_source;
+
+#endif // RTC_H
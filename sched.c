@@ -0,0 +1,130 @@
+// Title:    Cooperative scheduler
+// File:     sched.c
+//
+
+#include <stddef.h>
+#include <avr/io.h>
+#include <util/atomic.h>
+#include "sched.h"
+#include "power.h"
+
+#define WHEEL_MASK  (SCHED_WHEEL_SIZE - 1)
+
+volatile uint16_t sched_ticks;
+
+static struct task *wheel[SCHED_WHEEL_SIZE];
+// the last tick whose slot has been looked at
+static uint16_t cursor;
+
+void sched_add(struct task *task, uint16_t delay)
+{
+    uint8_t slot = (cursor + delay) & WHEEL_MASK;
+
+    task->rounds = (delay - 1) / SCHED_WHEEL_SIZE;
+    task->next = wheel[slot];
+    wheel[slot] = task;
+}
+
+void sched_remove(struct task *task)
+{
+    struct task **link;
+    uint8_t slot;
+
+    for (slot = 0; slot < SCHED_WHEEL_SIZE; slot++) {
+        for (link = &wheel[slot]; *link; link = &(*link)->next) {
+            if (*link == task) {
+                *link = task->next;
+                return;
+            }
+        }
+    }
+}
+
+#if SCHED_STATS
+// The time now: ticks, and crystal cycles into the tick.  Timer1 counts
+// CPU cycles and is cleared on every tick, and power.c keeps each tick
+// POWER_TICK_CYCLES long at either speed.
+static void sched_time(uint16_t *ticks, uint16_t *cycles)
+{
+    uint16_t count;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        *ticks = sched_ticks;
+        count = TCNT1;
+        // A tick that has not been serviced yet, power.c has not
+        // started counting it either
+        if ((TIFR & _BV(OCF1A)) && (count < OCR1A / 2)) {
+            (*ticks)++;
+            *cycles = count << power_shift;
+        } else {
+            *cycles = power_cycles(count);
+        }
+    }
+}
+
+static void run_task(struct task *task)
+{
+    uint16_t start_ticks, start_cycles, end_ticks, end_cycles;
+    uint32_t cycles;
+
+    sched_time(&start_ticks, &start_cycles);
+    task->run();
+    sched_time(&end_ticks, &end_cycles);
+    // ticks wrap after a few minutes, far longer than a task runs
+    cycles = (uint32_t)(uint16_t)(end_ticks - start_ticks) *
+        POWER_TICK_CYCLES + end_cycles - start_cycles;
+    if (cycles > task->max_cycles)
+        task->max_cycles = (cycles > 0xFFFF) ? 0xFFFF : cycles;
+    // the total stops with the count, so it divides into the average
+    if (task->runs != 0xFFFF) {
+        task->runs++;
+        task->total_cycles += cycles;
+    }
+}
+#else
+#define run_task(task) (task)->run()
+#endif
+
+void sched_run(void)
+{
+    struct task *due = NULL;
+    struct task **link;
+    struct task *task;
+    uint16_t now;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        now = sched_ticks;
+    }
+
+    // collect everything due up to now
+    while (cursor != now) {
+        cursor++;
+        link = &wheel[cursor & WHEEL_MASK];
+        while ((task = *link)) {
+            if (task->rounds) {
+                task->rounds--;
+                link = &task->next;
+            } else {
+                *link = task->next;
+                task->next = due;
+                due = task;
+            }
+        }
+    }
+
+    // Run them after the wheel has been walked, so a task can put
+    // itself or others back on it.
+    while ((task = due)) {
+        due = task->next;
+        if (task->period)
+            sched_add(task, task->period);
+        run_task(task);
+    }
+}
+
+uint8_t sched_due(void)
+{
+    return cursor != sched_ticks;
+}
@@ -0,0 +1,67 @@
+// Title:    Cooperative scheduler
+// File:     sched.h
+//
+// Periodic tasks run from the main loop, timed by the 200 Hz tick of
+// Timer1.  Tasks live in a hashed timer wheel: a task due in d ticks
+// goes on the list of slot (now + d) mod SCHED_WHEEL_SIZE and waits
+// (d - 1) / SCHED_WHEEL_SIZE turns of the wheel, so adding a task is
+// O(1) and each tick only looks at one slot.  Tasks are statically
+// allocated by their owners, there is no heap.
+//
+// A task that runs late is not run again to catch up; it runs once and
+// its next run is one period after that.
+//
+
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <inttypes.h>
+
+// ticks per second, set by the Timer1 compare value
+#define SCHED_HZ 200
+
+// must be a power of two
+#define SCHED_WHEEL_SIZE 16
+
+#ifndef SCHED_STATS
+#define SCHED_STATS 1
+#endif
+
+struct task {
+    struct task *next;
+    void (*run)(void);
+    uint16_t period;        // ticks between runs, 0 for a one shot task
+    uint8_t rounds;         // turns of the wheel left before it is due
+#if SCHED_STATS
+    uint16_t runs;          // times run, stops at 0xFFFF
+    uint16_t max_cycles;    // longest run in crystal cycles, stops at 0xFFFF
+    uint32_t total_cycles;  // sum over the runs counted
+#endif
+};
+
+#define TASK(fn, period) { 0, fn, period, 0 }
+
+// Ticks counted by the timer interrupt.
+extern volatile uint16_t sched_ticks;
+
+// Called from the timer interrupt once a tick.
+static inline void sched_tick(void)
+{
+    sched_ticks++;
+}
+
+// Put task on the wheel, due in delay ticks (at least 1).  The task
+// must not already be on the wheel.
+void sched_add(struct task *task, uint16_t delay);
+
+// Take task off the wheel.  Does nothing if it is not on it.
+void sched_remove(struct task *task);
+
+// Run the tasks due since the last call.  Call from the main loop.
+void sched_run(void);
+
+// Non-zero if a tick has come since sched_run() last looked.  Call with
+// interrupts off.
+uint8_t sched_due(void);
+
+#endif // SCHED_H
@@ -0,0 +1,36 @@
+// Title:    Stack monitor
+// File:     stackmon.c
+//
+
+#include <avr/io.h>
+#include "stackmon.h"
+
+// from the linker script, the end of .noinit and the top of RAM
+extern uint8_t _end;
+extern uint8_t __stack;
+
+// Runs from the startup code once the stack pointer is set, before
+// anything is on the stack.  There is no frame, p lives in registers.
+void stack_paint(void) __attribute__((naked, used, section(".init3")));
+
+void stack_paint(void)
+{
+    uint8_t *p = &_end;
+
+    while (p <= &__stack)
+        *p++ = STACK_PAINT;
+}
+
+uint16_t stack_unused(void)
+{
+    const uint8_t *p = &_end;
+
+    while ((p <= &__stack) && (*p == STACK_PAINT))
+        p++;
+    return p - &_end;
+}
+
+uint16_t stack_size(void)
+{
+    return &__stack - &_end + 1;
+}
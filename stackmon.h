@@ -0,0 +1,22 @@
+// Title:    Stack monitor
+// File:     stackmon.h
+//
+// The free RAM between the end of the variables and the stack is
+// painted with STACK_PAINT at startup.  How much of it is still
+// painted shows how close the stack has come to the variables.
+//
+
+#ifndef STACKMON_H
+#define STACKMON_H
+
+#include <inttypes.h>
+
+#define STACK_PAINT 0xC5
+
+// Bytes of free RAM the stack has never used since reset.
+uint16_t stack_unused(void);
+
+// Bytes of free RAM at reset, between the variables and the stack.
+uint16_t stack_size(void);
+
+#endif // STACKMON_H
@@ -0,0 +1,138 @@
+// Title:    Stopwatch and countdown timer
+// File:     stopwatch.c
+//
+
+#include <util/atomic.h>
+#include "sched.h"
+#include "alarm.h"
+#include "stopwatch.h"
+
+#define MINUTE_TICKS    (60UL * SCHED_HZ)
+
+struct watch {
+    uint32_t ticks;
+    uint16_t mark;          // sched_ticks when ticks was brought up to date
+    uint8_t running;
+};
+
+static struct watch stopwatch;
+static struct watch countdown;
+// length the countdown was set to, it counts up to this
+static uint32_t countdown_length;
+static uint32_t laps[STOPWATCH_LAPS];
+static uint8_t lap_count;
+
+static uint16_t now(void)
+{
+    uint16_t ticks;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        ticks = sched_ticks;
+    }
+    return ticks;
+}
+
+// sched_ticks wraps after 327 seconds, fine as long as this is called
+// more often than that
+static void watch_update(struct watch *watch)
+{
+    uint16_t ticks = now();
+
+    if (watch->running)
+        watch->ticks += (uint16_t)(ticks - watch->mark);
+    watch->mark = ticks;
+}
+
+static void watch_toggle(struct watch *watch)
+{
+    watch_update(watch);
+    watch->running = !watch->running;
+}
+
+void stopwatch_poll(void)
+{
+    watch_update(&stopwatch);
+    watch_update(&countdown);
+    if (countdown.running && (countdown.ticks >= countdown_length)) {
+        countdown.running = 0;
+        countdown.ticks = 0;
+        alarm_ring();
+    }
+}
+
+void stopwatch_toggle(void)
+{
+    watch_toggle(&stopwatch);
+}
+
+uint8_t stopwatch_running(void)
+{
+    return stopwatch.running;
+}
+
+void stopwatch_lap(void)
+{
+    uint8_t n;
+
+    watch_update(&stopwatch);
+    for (n = STOPWATCH_LAPS - 1; n > 0; n--)
+        laps[n] = laps[n - 1];
+    laps[0] = stopwatch.ticks;
+    if (lap_count < STOPWATCH_LAPS)
+        lap_count++;
+}
+
+void stopwatch_reset(void)
+{
+    stopwatch.running = 0;
+    stopwatch.ticks = 0;
+    lap_count = 0;
+}
+
+uint32_t stopwatch_ticks(void)
+{
+    watch_update(&stopwatch);
+    return stopwatch.ticks;
+}
+
+uint8_t stopwatch_lap_count(void)
+{
+    return lap_count;
+}
+
+uint32_t stopwatch_lap_ticks(uint8_t n)
+{
+    return laps[n];
+}
+
+void countdown_add_minute(void)
+{
+    if (countdown.running)
+        return;
+    // start again from the time left
+    countdown_length -= countdown.ticks;
+    countdown.ticks = 0;
+    countdown_length += MINUTE_TICKS;
+    if (countdown_length > 99 * MINUTE_TICKS)
+        countdown_length = 0;
+}
+
+void countdown_toggle(void)
+{
+    if (countdown.running || (countdown.ticks < countdown_length))
+        watch_toggle(&countdown);
+}
+
+uint8_t countdown_running(void)
+{
+    return countdown.running;
+}
+
+uint32_t countdown_ticks(void)
+{
+    watch_update(&countdown);
+    if (countdown.ticks >= countdown_length)
+        return 0;
+    return countdown_length - countdown.ticks;
+}
@@ -0,0 +1,50 @@
+// Title:    Stopwatch and countdown timer
+// File:     stopwatch.h
+//
+// Both count scheduler ticks, 5 ms each.  They keep no state in the
+// timer interrupt: the elapsed time is brought up to date from
+// sched_ticks whenever it is asked for and by stopwatch_poll().
+//
+
+#ifndef STOPWATCH_H
+#define STOPWATCH_H
+
+#include <inttypes.h>
+
+#define STOPWATCH_LAPS  8
+
+// Bring both timers up to date and end the countdown when it reaches
+// zero.  Call at least every few minutes; every tick gives an
+// accurate countdown end.
+void stopwatch_poll(void);
+
+// Start or stop the stopwatch.
+void stopwatch_toggle(void);
+uint8_t stopwatch_running(void);
+
+// Record the current time as a lap.  Once STOPWATCH_LAPS are recorded
+// the oldest is dropped.
+void stopwatch_lap(void);
+
+// Stop the stopwatch, set it to zero and forget the laps.
+void stopwatch_reset(void);
+
+// Ticks counted by the stopwatch.
+uint32_t stopwatch_ticks(void);
+
+// Number of laps recorded and lap n, 0 being the most recent.
+uint8_t stopwatch_lap_count(void);
+uint32_t stopwatch_lap_ticks(uint8_t n);
+
+// Add a minute to the countdown, up to 99 minutes.  Only while the
+// countdown is stopped.
+void countdown_add_minute(void);
+
+// Start or pause the countdown.
+void countdown_toggle(void);
+uint8_t countdown_running(void);
+
+// Ticks left to count down.
+uint32_t countdown_ticks(void);
+
+#endif // STOPWATCH_H
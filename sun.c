@@ -0,0 +1,247 @@
+// Title:    Sunrise, sunset and moon phase
+// File:     sun.c
+//
+// The sunrise equation as on Wikipedia, with days counted from noon UT
+// on 1 January 2000.  Angles are in turns, so the integer part of a
+// 16.16 angle can be dropped; a turn of hour angle is a day.  The
+// anomaly and the lunation grow by a fraction of a turn a day too small
+// for 16.16 over a century, so they are summed in 0.32 turns, where
+// wrapping is free.
+//
+
+#include <avr/pgmspace.h>
+#include "sun.h"
+
+// x in 16.16, at compile time
+#define FIX(x) ((int32_t)((x) * 65536.0 + ((x) < 0 ? -0.5 : 0.5)))
+// fraction x of a turn in 0.32, wrapped, at compile time
+#define TURN32(x) ((uint32_t)(int64_t)(((x) + 4) * 4294967296.0))
+
+// 1 January 2020 is this many days after 1 January 2000
+#define SUN_EPOCH 7305
+// the mean anomaly a day, and at noon UT on the epoch less the time
+// from there to solar noon at the longitude
+#define SUN_RATE ((uint32_t)(0.98560028 / 360 * 4294967296.0 + 0.5))
+#define SUN_M0 TURN32(357.5291 / 360 - \
+        0.98560028 / 360 * SUN_LONGITUDE / 360)
+// a lunation a day, and the new moon of 6 January 2000 at 18:14 UT
+#define MOON_RATE ((uint32_t)(4294967296.0 / 29.530588853 + 0.5))
+#define MOON_P0 TURN32(-5.2597 / 29.530588853)
+
+// quarter turn
+#define QUARTER 0x4000
+
+enum {
+    SUN_ANOMALY,
+    SUN_DECLINATION,
+    SUN_COSINE,
+    SUN_ASIN,
+    SUN_ASIN_END,
+    SUN_LOCAL,
+    SUN_MOON,
+    SUN_DONE
+};
+
+// sine of a quarter turn in 64 steps, 0.16
+static const PROGMEM uint16_t sine_table[65] = {
+    0, 1608, 3216, 4821, 6424, 8022, 9616, 11204,
+    12785, 14359, 15924, 17479, 19024, 20557, 22078, 23586,
+    25080, 26558, 28020, 29466, 30893, 32303, 33692, 35062,
+    36410, 37736, 39040, 40320, 41576, 42806, 44011, 45190,
+    46341, 47464, 48559, 49624, 50660, 51665, 52639, 53581,
+    54491, 55368, 56212, 57022, 57798, 58538, 59244, 59914,
+    60547, 61145, 61705, 62228, 62714, 63162, 63572, 63944,
+    64277, 64571, 64827, 65043, 65220, 65358, 65457, 65516,
+    65535,
+};
+
+struct sun_times sun_today = { SUN_NONE };
+
+static struct sun_times next;
+static uint16_t year;
+static struct tz_zone *zone;
+static uint8_t step = SUN_DONE;
+// the mean anomaly and the ecliptic longitude, turns
+static int32_t anomaly;
+static int32_t lambda;
+// solar noon, days after midnight UTC
+static int32_t transit;
+// the hour angle's cosine is high / wide
+static int32_t high;
+static int32_t wide;
+// the hour angle is base + sign * asin(target), turns
+static int32_t target;
+static int16_t base;
+static int8_t sign;
+// the arcsine so far and the next step of it, turns
+static int16_t angle;
+static int16_t angle_step;
+
+// a * b in 16.16 with |b| < 1, as 16 x 16 bit multiplies; rounded
+// down, as the shift of the full product would be
+static int32_t sun_mul(int32_t a, int32_t b)
+{
+    uint16_t low;
+
+    if (b < 0) {
+        a = -a;
+        b = -b;
+    }
+    low = b;
+    return (int32_t)(int16_t)(a >> 16) * low +
+        (((uint32_t)(uint16_t)a * low) >> 16);
+}
+
+// sine of the fraction of a turn in a, 16.16
+static int32_t sun_sin(int32_t a)
+{
+    uint16_t x = a & (QUARTER - 1);
+    uint8_t quadrant = (uint16_t)a >> 14;
+    int32_t y;
+    uint8_t i;
+
+    if (quadrant & 1)
+        x = QUARTER - x;
+    i = x >> 8;
+    y = pgm_read_word(&sine_table[i]);
+    if (i < 64)
+        y += ((int32_t)pgm_read_word(&sine_table[i + 1]) - y) *
+            (uint8_t)x >> 8;
+    return (quadrant & 2) ? -y : y;
+}
+
+static uint16_t sun_sqrt(uint32_t x)
+{
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x)
+        bit >>= 2;
+    while (bit) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// minutes of the 16.16 days t
+static int16_t sun_minutes(int32_t t)
+{
+    return (t * 1440 + 0x8000) >> 16;
+}
+
+// local minutes after midnight of UTC minutes after midnight
+static int16_t sun_local(int16_t minutes)
+{
+    uint32_t utc = next.days * 1440UL + minutes;
+    uint8_t dst;
+
+    // before the epoch, a day later is the same time of day
+    if ((int32_t)utc < 0)
+        utc += 1440;
+    return tz_local(zone, year, utc, &dst) % 1440;
+}
+
+void sun_start(uint16_t days, uint16_t in_year, struct tz_zone *in_zone)
+{
+    next.days = days;
+    year = in_year;
+    zone = in_zone;
+    step = SUN_ANOMALY;
+}
+
+uint8_t sun_step(void)
+{
+    uint32_t turns;
+    int32_t sine, cosine, latitude;
+    uint8_t n;
+
+    switch (step) {
+    case SUN_ANOMALY:
+        // mean anomaly, the equation of the centre and the ecliptic
+        // longitude; the 0.0003 sin 3M term is below 16.16
+        turns = SUN_M0 + SUN_RATE * (uint32_t)(next.days + SUN_EPOCH);
+        anomaly = turns >> 16;
+        sine = sun_sin(anomaly);
+        lambda = anomaly + sun_mul(FIX(1.9148 / 360), sine) +
+            sun_mul(FIX(0.0200 / 360), sun_sin(anomaly * 2)) +
+            FIX(282.9372 / 360);
+        transit = FIX(0.5 - SUN_LONGITUDE / 360) +
+            sun_mul(FIX(0.0053), sine) -
+            sun_mul(FIX(0.0069), sun_sin(lambda * 2));
+        break;
+    case SUN_DECLINATION:
+        sine = sun_mul(sun_sin(lambda), FIX(0.397777));
+        cosine = 65536 - sun_mul(sine, sine);
+        cosine = sun_sqrt((cosine > 0xFFFF ? 0xFFFF : cosine) << 16);
+        latitude = FIX(SUN_LATITUDE / 360);
+        high = FIX(-0.014538) - sun_mul(sun_sin(latitude), sine);
+        wide = sun_mul(sun_sin(latitude + QUARTER), cosine);
+        break;
+    case SUN_COSINE:
+        if (high >= wide) {
+            next.rise = next.set = SUN_ALWAYS_DOWN;
+            step = SUN_MOON;
+            return 1;
+        }
+        if (high <= -wide) {
+            next.rise = next.set = SUN_ALWAYS_UP;
+            step = SUN_MOON;
+            return 1;
+        }
+        // |high| < wide, so high << 15 fits; the remainder gives the
+        // last bit
+        cosine = (high << 15) / wide;
+        cosine = cosine * 2 + ((high << 15) - cosine * wide) * 2 / wide;
+        base = QUARTER;
+        sign = -1;
+        target = cosine;
+        if ((cosine > FIX(0.7071)) || (cosine < -FIX(0.7071))) {
+            // arccos is steep near the ends, the arcsine of the sine
+            // is not
+            target = sun_sqrt((65536 - sun_mul(cosine, cosine)) << 16);
+            if (cosine > 0) {
+                base = 0;
+                sign = 1;
+            } else {
+                base = 2 * QUARTER;
+            }
+        }
+        angle = 0;
+        angle_step = QUARTER / 2;
+        break;
+    case SUN_ASIN:
+    case SUN_ASIN_END:
+        // arcsine by halving, seven bits a step
+        for (n = 0; n < 7; n++) {
+            if (sun_sin(angle) < target)
+                angle += angle_step;
+            else
+                angle -= angle_step;
+            angle_step >>= 1;
+        }
+        break;
+    case SUN_LOCAL:
+        angle = base + sign * angle;
+        next.rise = sun_local(sun_minutes(transit - angle));
+        next.set = sun_local(sun_minutes(transit + angle));
+        break;
+    case SUN_MOON:
+        // the phase at noon UT and the part of the disc lit by it
+        turns = MOON_P0 + MOON_RATE * (uint32_t)(next.days + SUN_EPOCH);
+        next.moon_phase = turns >> 24;
+        cosine = sun_sin((turns >> 16) + QUARTER);
+        next.moon_lit = ((65536 - cosine) * 50 + 0x8000) >> 16;
+        sun_today = next;
+        break;
+    default:
+        return 0;
+    }
+    step++;
+    return step != SUN_DONE;
+}
@@ -0,0 +1,53 @@
+// Title:    Sunrise, sunset and moon phase
+// File:     sun.h
+//
+// Sunrise and sunset at SUN_LATITUDE, SUN_LONGITUDE by the sunrise
+// equation, and the moon's phase by the mean lunation, in 16.16 fixed
+// point with no floating point at run time.  The upper limb is taken to
+// touch the horizon with the sun's centre 0.833 degrees below it.
+//
+// A day's answer is worked out once, a step at a time: sun_start() and
+// then sun_step() from a task until it returns zero.  The longest step
+// is two 32 bit divisions and a square root, or seven table sines, a
+// few thousand cycles by count, not measured; run them in a power
+// burst.  sun_today only changes when the last step is done.
+//
+
+#ifndef SUN_H
+#define SUN_H
+
+#include <inttypes.h>
+#include "tz.h"
+
+// degrees north and east, constants only
+#ifndef SUN_LATITUDE
+#define SUN_LATITUDE 45.42
+#endif
+#ifndef SUN_LONGITUDE
+#define SUN_LONGITUDE -75.70
+#endif
+
+// rise and set for days the sun does not cross the horizon
+#define SUN_ALWAYS_UP -1
+#define SUN_ALWAYS_DOWN -2
+// sun_today.days before the first day is done
+#define SUN_NONE 0xFFFF
+
+struct sun_times {
+    uint16_t days;          // date, days since 1 January 2020
+    int16_t rise;           // minutes after local midnight
+    int16_t set;
+    uint8_t moon_phase;     // 0 new, 64 first quarter, 128 full, 192 last
+    uint8_t moon_lit;       // percent of the disc lit, at noon UTC
+};
+
+extern struct sun_times sun_today;
+
+// Start on the day days since 1 January 2020, in year, with the times
+// in zone.  A day being worked on is dropped.
+void sun_start(uint16_t days, uint16_t year, struct tz_zone *zone);
+
+// Do the next step.  Returns non-zero while there are steps left.
+uint8_t sun_step(void);
+
+#endif // SUN_H
@@ -0,0 +1,117 @@
+// Title:    Telemetry
+// File:     telemetry.c
+//
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <util/crc16.h>
+#include "powerfail.h"
+#include "power.h"
+#include "telemetry.h"
+
+#if TELEMETRY_ENABLE
+
+#if POWERFAIL_ENABLE
+#error "TELEMETRY_ENABLE and POWERFAIL_ENABLE both need PB3"
+#endif
+
+#define BAUD TELEMETRY_BAUD
+#include <util/setbaud.h>
+
+#define RING_MASK (TELEMETRY_RING_SIZE - 1)
+
+// The interrupt takes bytes at tail, telemetry_send() puts them at
+// head.  Each side only writes its own index.
+static uint8_t ring[TELEMETRY_RING_SIZE];
+static volatile uint8_t head;
+static volatile uint8_t tail;
+
+void telemetry_init(void)
+{
+    UBRR1H = UBRRH_VALUE;
+    UBRR1L = UBRRL_VALUE;
+#if USE_2X
+    UCSR1A = _BV(U2X1);
+#else
+    UCSR1A = 0;
+#endif
+    // 8N1, UCSR1C shares its address with UBRR1H
+    UCSR1C = _BV(URSEL1) | _BV(UCSZ11) | _BV(UCSZ10);
+    UCSR1B = _BV(TXEN1);
+}
+
+//
+// COBS: each run of non-zero bytes goes out after a code byte of its
+// length plus one, and the zero that ends it is left out.  A run of 254
+// non-zero bytes has code 0xFF and no zero after it.  The code byte is
+// only known at the end of its run, so its place is kept and filled in
+// then; the interrupt can't see any of it until head moves.
+//
+uint8_t telemetry_send(const void *frame, uint8_t length)
+{
+    const uint8_t *data = frame;
+    uint8_t crc = 0;
+    uint8_t at = head;
+    uint8_t space = (tail - at - 1) & RING_MASK;
+    uint8_t code_at = at++;
+    uint8_t code = 1;
+    uint8_t i, c;
+
+    // data, crc, a code byte per 254 and the closing zero
+    if (space < length + 3 + length / 254)
+        return 0;
+
+    for (i = 0; i <= length; i++) {
+        if (i < length) {
+            c = data[i];
+            crc = _crc8_ccitt_update(crc, c);
+        } else {
+            c = crc;
+        }
+        if (c) {
+            ring[at++ & RING_MASK] = c;
+            code++;
+        }
+        if (!c || (code == 0xFF)) {
+            ring[code_at & RING_MASK] = code;
+            code_at = at++;
+            code = 1;
+        }
+    }
+    ring[code_at & RING_MASK] = code;
+    ring[at++ & RING_MASK] = 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // the baud rate needs full speed until the last bit is out
+        if (!(UCSR1B & (_BV(UDRIE1) | _BV(TXCIE1))))
+            power_burst();
+        head = at & RING_MASK;
+        UCSR1B = (UCSR1B & ~_BV(TXCIE1)) | _BV(UDRIE1);
+    }
+    return 1;
+}
+
+ISR(USART1_UDRE_vect)
+{
+    uint8_t at = tail;
+
+    if (at == head) {
+        // the last byte is in the shift register, wait for it; TXC1
+        // may still be set from the frame before
+        UCSR1A |= _BV(TXC1);
+        UCSR1B = (UCSR1B & ~_BV(UDRIE1)) | _BV(TXCIE1);
+        return;
+    }
+    UDR1 = ring[at];
+    tail = (at + 1) & RING_MASK;
+}
+
+ISR(USART1_TXC_vect)
+{
+    UCSR1B &= ~_BV(TXCIE1);
+    power_burst_end();
+}
+
+#endif
@@ -0,0 +1,66 @@
+// Title:    Telemetry
+// File:     telemetry.h
+//
+// Once a second the clock sends a binary frame out of USART1 (TXD1 is
+// PB3).  The frame is COBS encoded, so it has no zero bytes in it, and
+// ends with a zero.  The last byte before the zero is a CRC-8 (CCITT,
+// polynomial 0x07) over the rest.  Fields are little-endian.
+//
+// The bytes go out from a ring buffer under the data register empty
+// interrupt, so sending never waits on the line.  A frame that does not
+// fit in the ring is dropped whole; the sequence number shows the gap.
+// tools/teledecode.c prints the frames on a PC.
+//
+// PB3 is also AIN1, which powerfail.c watches, so the two can't both
+// be enabled.
+//
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <inttypes.h>
+
+#ifndef TELEMETRY_ENABLE
+#define TELEMETRY_ENABLE 0
+#endif
+
+#ifndef TELEMETRY_BAUD
+#define TELEMETRY_BAUD 9600
+#endif
+
+// bytes, must be a power of two
+#define TELEMETRY_RING_SIZE 64
+
+#define TELEMETRY_VERSION 1
+
+struct telemetry {
+    uint8_t version;        // TELEMETRY_VERSION
+    uint8_t sequence;       // counts frames, wraps
+    uint32_t seconds;       // since 1 January 2020, local time
+    uint8_t subticks;       // ticks left in this second, 200 down to 1
+    int8_t drift;           // ticks ahead of the RTC at the last sync
+    uint8_t reset_flags;    // MCUCSR at reset, see reset.h
+    uint8_t presses[3];     // presses of buttons 0 - 2, wrap
+    uint16_t isr_max;       // the diag.h snapshot, all zero without it
+    uint16_t isr_avg;
+    uint16_t loops;
+    uint16_t lcd_bytes;
+    uint16_t lcd_spins;
+    uint16_t stack_used;
+};
+
+#if TELEMETRY_ENABLE
+
+// Set up USART1 to send only.
+void telemetry_init(void);
+
+// Queue a frame of length bytes.  Returns zero if it did not fit.
+uint8_t telemetry_send(const void *frame, uint8_t length);
+
+#else
+
+static inline void telemetry_init(void) {}
+
+#endif
+
+#endif // TELEMETRY_H
@@ -0,0 +1,344 @@
+// Title:    Alarm check
+// File:     tools/alarmcheck.c
+//
+// Runs alarm.c, tz.c and date.c on the PC through a year of minutes in
+// three zones: EST5EDT, the default, and CET and AEST for a change at
+// 3:00 and a southern summer.  Each alarm is checked to go off exactly
+// when the wall clock first reaches its time on each day it is for:
+// in the hour skipped in spring that is the jump past it, in the hour
+// repeated in autumn the first time round only.  The wall clock the
+// alarms are checked against comes from the C library's TZ handling,
+// which also checks the clock's own idea of the local time.  A once
+// alarm must be in EEPROM as off after it has gone off.
+//
+// The minute step and daylight saving change of clock.c's timer
+// interrupt are copied here, clock.c itself does not build on the PC.
+//
+// Built and run with "make check".
+//
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "../alarm.h"
+#include "../date.h"
+#include "../eemap.h"
+#include "../tz.h"
+
+// 1 January 2020 00:00 UTC in minutes since 1970
+#define EPOCH_MINUTES (1577836800L / 60)
+// the year simulated, starting on 1 January local time, and a day more
+#define YEAR 2024
+#define DAYS 367
+
+uint8_t host_eeprom[E2END + 1];
+
+static uint8_t checkpoint_busy;
+
+uint8_t persist_busy(void)
+{
+    return checkpoint_busy;
+}
+
+struct zone_case {
+    const char *posix;
+    struct tz_rule rule;        // all zero for the default
+};
+
+static const struct zone_case zones[] = {
+    { "EST5EDT,M3.2.0,M11.1.0" },
+    { "CET-1CEST,M3.5.0,M10.5.0/3",
+      { { "CET", "CEST" }, 1 * 4, 4, { 3 << 4 | 5, 0 << 5 | 2 },
+        { 10 << 4 | 5, 0 << 5 | 3 }, 0, 0 } },
+    { "AEST-10AEDT,M10.1.0,M4.1.0/3",
+      { { "AEST", "AEDT" }, 10 * 4, 4, { 10 << 4 | 1, 0 << 5 | 2 },
+        { 4 << 4 | 1, 0 << 5 | 3 }, 0, 0 } },
+};
+#define ZONES (sizeof(zones) / sizeof(zones[0]))
+
+// Once alarms go on the days of change in all three zones
+static const uint16_t change_days[][3] = {
+    { 2024, 3, 10 }, { 2024, 11, 3 },       // EST5EDT
+    { 2024, 3, 31 }, { 2024, 10, 27 },      // CET
+    { 2024, 4, 7 }, { 2024, 10, 6 },        // AEST
+};
+#define CHANGE_DAYS (sizeof(change_days) / sizeof(change_days[0]))
+
+// minutes of the day, around midnight and the changes
+static const uint16_t times[] = {
+    0, 59, 60, 89, 119, 120, 150, 179, 180, 181, 210, 239, 240,
+    390, 1439
+};
+#define TIMES (sizeof(times) / sizeof(times[0]))
+
+// the wall clock as clock.c keeps it
+static struct tz_zone zone;
+static struct {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t dst;
+} wall;
+static uint32_t day_stamp;
+static uint32_t dst_change;
+
+// the reference: the wall clock's minute stamp for each UTC minute of
+// the run, from the C library
+static long start_utc;
+static uint32_t *reference;
+static long minutes;
+
+static unsigned failures;
+static unsigned checked;
+
+static void fail(const char *what)
+{
+    if (failures++ < 20)
+        printf("alarmcheck: %s\n", what);
+}
+
+// clock_dst_schedule()
+static void clock_dst_schedule(void)
+{
+    wall.dst = tz_dst(&zone, wall.year, alarm_now, wall.dst);
+    dst_change = tz_next(&zone, wall.year, alarm_now, wall.dst);
+}
+
+// The minute step of clock_second() and clock_dst_change().  The
+// housekeeping after a change is done straight away; on the AVR it is
+// within the second.
+static void clock_minute(void)
+{
+    uint16_t change;
+    uint8_t jumped = 0;
+
+    wall.minute++;
+    if (wall.minute > 59) {
+        wall.minute = 0;
+        wall.hour++;
+        if (wall.hour > 23) {
+            wall.hour = 0;
+            wall.day++;
+            if (wall.day > days_in_month(wall.year, wall.month)) {
+                wall.day = 1;
+                wall.month++;
+                if (wall.month > 12) {
+                    wall.month = 1;
+                    wall.year++;
+                }
+            }
+            day_stamp = date_days(wall.year, wall.month, wall.day) * 1440UL;
+        }
+        if (day_stamp + wall.hour * 60 == dst_change) {
+            change = wall.hour * 60;
+            if (wall.dst)
+                change -= tz_shift(&zone);
+            else
+                change += tz_shift(&zone);
+            wall.dst = !wall.dst;
+            wall.hour = change / 60;
+            wall.minute = change % 60;
+            dst_change = TZ_NEVER;
+            jumped = 1;
+        }
+    }
+    alarm_now = day_stamp + wall.hour * 60 + wall.minute;
+    if (jumped)
+        clock_dst_schedule();
+}
+
+static void clock_start(void)
+{
+    wall.year = YEAR;
+    wall.month = 1;
+    wall.day = 1;
+    wall.hour = 0;
+    wall.minute = 0;
+    wall.dst = 0;
+    day_stamp = date_days(wall.year, wall.month, wall.day) * 1440UL;
+    alarm_now = day_stamp;
+    clock_dst_schedule();
+}
+
+// Wall clock minute stamp of the broken down local time tm.
+static uint32_t tm_stamp(struct tm *tm)
+{
+    struct tm utc = *tm;
+
+    return timegm(&utc) / 60 - EPOCH_MINUTES;
+}
+
+static void zone_start(const struct zone_case *z)
+{
+    struct tm tm;
+    time_t t;
+    long u;
+
+    setenv("TZ", z->posix, 1);
+    tzset();
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = YEAR - 1900;
+    tm.tm_mday = 1;
+    tm.tm_isdst = -1;
+    start_utc = mktime(&tm) / 60;
+    minutes = DAYS * 1440L;
+    reference = realloc(reference, (minutes + 1) * sizeof(*reference));
+    for (u = 0; u <= minutes; u++) {
+        t = (start_utc + u) * 60;
+        localtime_r(&t, &tm);
+        reference[u] = tm_stamp(&tm);
+    }
+
+    memset(host_eeprom, 0xFF, sizeof(host_eeprom));
+    if (z->rule.name[0][0]) {
+        struct tz_rule rule = z->rule;
+        const uint8_t *p = (const uint8_t *)&rule;
+        uint8_t n;
+
+        rule.crc = 0;
+        for (n = 0; n < TZ_RECORD_SIZE - 1; n++)
+            rule.crc = _crc8_ccitt_update(rule.crc, p[n]);
+        memcpy(host_eeprom + EEMAP_TZ, &rule, sizeof(rule));
+    }
+    tz_load(0, &zone);
+}
+
+// Non-zero if alarm is for the day days since 1 January 2020.
+static uint8_t alarm_on(const struct alarm *alarm, long days)
+{
+    time_t t = (EPOCH_MINUTES + days * 1440 + 720) * 60;
+    struct tm tm;
+
+    gmtime_r(&t, &tm);
+    switch (alarm->type) {
+    case ALARM_ONCE:
+        return alarm->date == days;
+    case ALARM_DAILY:
+        return 1;
+    case ALARM_WEEKDAYS:
+        return (alarm->weekdays >> tm.tm_wday) & 1;
+    }
+    return 0;
+}
+
+// Run the year with alarm set as alarm 0 and compare the minutes it
+// goes off at with the reference.
+static void run(const struct zone_case *z, const struct alarm *alarm)
+{
+    uint32_t start = reference[0];
+    uint32_t target;
+    long first = start / 1440;
+    // past the end of the run by more than a week
+    long last = first + DAYS + 7;
+    long days, u;
+    uint8_t want;
+    struct alarm saved;
+    char what[128];
+
+    memset(host_eeprom + EEMAP_ALARMS, 0xFF,
+            ALARM_COUNT * sizeof(struct alarm));
+    clock_start();
+    alarm_init();
+
+    // the write waits for a checkpoint to finish
+    checkpoint_busy = 1;
+    alarm_set(0, alarm);
+    alarm_poll();
+    eeprom_read_block(&saved, (const void *)EEMAP_ALARMS, sizeof(saved));
+    if (saved.type != 0xFF)
+        fail("alarm written while a checkpoint was being written");
+    checkpoint_busy = 0;
+    alarm_poll();
+    eeprom_read_block(&saved, (const void *)EEMAP_ALARMS, sizeof(saved));
+    if (memcmp(&saved, alarm, sizeof(saved)))
+        fail("alarm not written once the checkpoint was done");
+    alarm_init();
+
+    // the first day it is for after the start; it goes off the first
+    // minute the wall clock is at its time or past it
+    for (days = first; days < last; days++) {
+        target = days * 1440 + alarm->hour * 60 + alarm->minute;
+        if (alarm_on(alarm, days) && target > start)
+            break;
+    }
+
+    for (u = 1; u <= minutes; u++) {
+        clock_minute();
+        if (alarm_now != reference[u]) {
+            snprintf(what, sizeof(what), "%s: wall clock %lu, "
+                    "C library %lu", z->posix, (unsigned long)alarm_now,
+                    (unsigned long)reference[u]);
+            fail(what);
+            return;
+        }
+        alarm_check();
+        alarm_poll();
+
+        want = days < last && reference[u] >= target;
+        if (alarm_ringing() != want) {
+            snprintf(what, sizeof(what), "%s: alarm %u %02u:%02u on %ld "
+                    "%s at wall %lu", z->posix, alarm->type, alarm->hour,
+                    alarm->minute, days, want ? "did not go off" :
+                    "went off", (unsigned long)reference[u]);
+            fail(what);
+        }
+        alarm_silence();
+        if (!want)
+            continue;
+        checked++;
+        // next day it is for, past the wall clock now
+        for (days++; days < last; days++) {
+            target = days * 1440 + alarm->hour * 60 + alarm->minute;
+            if (alarm_on(alarm, days) && target > reference[u])
+                break;
+        }
+    }
+
+    // a once alarm that went off is off after a reset too
+    eeprom_read_block(&saved, (const void *)EEMAP_ALARMS, sizeof(saved));
+    if (alarm->type == ALARM_ONCE && saved.type != ALARM_OFF) {
+        snprintf(what, sizeof(what), "%s: once alarm %02u:%02u on %u "
+                "went off but was not saved off", z->posix, alarm->hour,
+                alarm->minute, alarm->date);
+        fail(what);
+    }
+}
+
+int main(void)
+{
+    struct alarm alarm;
+    unsigned z, t, d;
+
+    for (z = 0; z < ZONES; z++) {
+        zone_start(&zones[z]);
+        memset(&alarm, 0, sizeof(alarm));
+        for (t = 0; t < TIMES; t++) {
+            alarm.hour = times[t] / 60;
+            alarm.minute = times[t] % 60;
+            alarm.type = ALARM_DAILY;
+            run(&zones[z], &alarm);
+            alarm.type = ALARM_WEEKDAYS;
+            alarm.weekdays = ALARM_MON_FRI;
+            run(&zones[z], &alarm);
+            alarm.weekdays = ALARM_SAT_SUN;
+            run(&zones[z], &alarm);
+            alarm.weekdays = 0;
+            alarm.type = ALARM_ONCE;
+            for (d = 0; d < CHANGE_DAYS; d++) {
+                alarm.date = date_days(change_days[d][0],
+                        change_days[d][1], change_days[d][2]);
+                run(&zones[z], &alarm);
+            }
+            alarm.date = 0;
+        }
+    }
+    printf("alarmcheck: %u alarms went off, %u failures\n", checked,
+            failures);
+    return failures != 0;
+}
@@ -0,0 +1,86 @@
+// Title:    Date check
+// File:     tools/datecheck.c
+//
+// Runs date.c on the PC for every day from 1 January 2020 to
+// 31 December 2119 and compares date_days(), date_civil(),
+// date_weekday(), days_in_month() and leap_year() with the C library's
+// timegm() and gmtime().
+//
+// Built and run with "make check".
+//
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "../date.h"
+
+// 1 January 2020 00:00 UTC
+#define EPOCH 1577836800L
+
+static unsigned failures;
+
+static void fail(const char *what, unsigned year, unsigned month,
+        unsigned day)
+{
+    if (failures++ < 20)
+        printf("datecheck: %04u-%02u-%02u: %s\n", year, month, day, what);
+}
+
+// days of month in year by the C library
+static unsigned month_length(unsigned year, unsigned month)
+{
+    struct tm tm;
+    time_t first, next;
+
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = 1;
+    first = timegm(&tm);
+    tm.tm_mon++;
+    next = timegm(&tm);
+    return (next - first) / 86400;
+}
+
+int main(void)
+{
+    struct tm tm;
+    time_t t;
+    long days;
+    uint16_t year;
+    uint8_t month, day;
+    unsigned checked = 0;
+
+    for (days = 0, t = EPOCH; ; days++, t += 86400) {
+        gmtime_r(&t, &tm);
+        if (tm.tm_year + 1900 > 2119)
+            break;
+        year = tm.tm_year + 1900;
+        month = tm.tm_mon + 1;
+        day = tm.tm_mday;
+
+        if (date_days(year, month, day) != days)
+            fail("date_days", year, month, day);
+        date_civil(days, &year, &month, &day);
+        if (year != tm.tm_year + 1900 || month != tm.tm_mon + 1 ||
+                day != tm.tm_mday)
+            fail("date_civil", tm.tm_year + 1900, tm.tm_mon + 1,
+                    tm.tm_mday);
+        if (date_weekday(days) != tm.tm_wday)
+            fail("date_weekday", year, month, day);
+        if (day == 1) {
+            if (days_in_month(year, month) != month_length(year, month))
+                fail("days_in_month", year, month, day);
+            if (month == 2 && leap_year(year) !=
+                    (month_length(year, month) == 29))
+                fail("leap_year", year, month, day);
+        }
+        checked++;
+    }
+    if (days != 36524)
+        fail("wrong number of days", year, month, day);
+
+    printf("datecheck: %u days, %u failures\n", checked, failures);
+    return failures != 0;
+}
@@ -0,0 +1,128 @@
+// Title:    Energy estimate
+// File:     tools/energy.c
+//
+// Works out the current the AVR draws in a build, and the mAh a day it
+// takes from a battery, from the counters on the diagnostics screen:
+//
+//     ISR avg     crystal cycles of the timer interrupt
+//     Fast/s      ticks a second at full speed
+//     tasks/s     from the task pages, each task's avg times its runs a
+//                 second, added up, in crystal cycles
+//     bursts/s    the part of tasks/s in power bursts: render, the RTC
+//                 sync and telemetry
+//
+// and the EEPROM bytes the build writes a day.  The counters are in
+// crystal cycles, so they are wall clock time whatever speed the CPU
+// ran at.  The currents are the datasheet's typical figures at 5V,
+// as in the README.  Main loop passes outside the tasks are not
+// counted.
+//
+// Reads lines of
+//
+//     build  policy  ISR-avg  Fast/s  tasks/s  bursts/s  EEPROM/day  limit
+//
+// from the file named, or standard input, and prints the estimate of
+// each.  limit is in mAh a day, 0 for none.  Exits non-zero when a build
+// goes over its limit or its counters come to more than a second.
+//
+// "make check" runs it on tools/energy.txt.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "../power.h"
+
+// mA per MHz, awake and in idle sleep
+#define ACTIVE_MA_PER_MHZ 1.5
+#define IDLE_MA_PER_MHZ   0.5
+// An EEPROM byte write takes 8.5ms.  The datasheet gives no current for
+// it; it is taken as this much on top of the CPU.
+#define EEPROM_WRITE_S    0.0085
+#define EEPROM_MA         2.0
+
+#define SECONDS_A_DAY     86400.0
+
+// Current at mhz MHz, for seconds a second at that speed, awake for
+// awake of them.
+static double speed_ma(double mhz, double seconds, double awake)
+{
+    return awake * ACTIVE_MA_PER_MHZ * mhz +
+        (seconds - awake) * IDLE_MA_PER_MHZ * mhz;
+}
+
+// Estimate one line of counters; returns non-zero if it fails.
+static int estimate(const char *line)
+{
+    char build[64];
+    unsigned policy;
+    double isr_avg, fast_ticks, tasks, bursts, eeprom, limit;
+    double fast_mhz = F_CPU / 1e6;
+    double slow_mhz = fast_mhz / (1 << POWER_SLOW_SHIFT);
+    double fast, isr, awake_fast, awake_slow, ma, mah;
+
+    if (sscanf(line, "%63s %u %lf %lf %lf %lf %lf %lf", build, &policy,
+                &isr_avg, &fast_ticks, &tasks, &bursts, &eeprom,
+                &limit) != 8 || policy > 2 || bursts > tasks) {
+        printf("energy: can't read \"%s\"\n", line);
+        return 1;
+    }
+
+    // seconds a second at full speed, and awake in the interrupt
+    fast = policy == 2 ? fast_ticks / SCHED_HZ : 1;
+    isr = isr_avg * SCHED_HZ / F_CPU;
+    switch (policy) {
+    case 0:
+        awake_fast = 1;
+        awake_slow = 0;
+        break;
+    case 1:
+        awake_fast = isr + tasks / F_CPU;
+        awake_slow = 0;
+        break;
+    default:
+        // the interrupt runs at either speed in proportion to the
+        // ticks at each, tasks other than bursts are taken as slow
+        awake_fast = bursts / F_CPU + isr * fast;
+        awake_slow = (tasks - bursts) / F_CPU + isr * (1 - fast);
+        break;
+    }
+    if (fast > 1 || awake_fast > fast || awake_slow > 1 - fast) {
+        printf("energy: %s: the counters come to more than a second\n",
+                build);
+        return 1;
+    }
+
+    ma = speed_ma(fast_mhz, fast, awake_fast) +
+        speed_ma(slow_mhz, 1 - fast, awake_slow) +
+        eeprom * EEPROM_WRITE_S * EEPROM_MA / SECONDS_A_DAY;
+    mah = ma * 24;
+    printf("energy: %-30s awake %4.1f%% fast %4.1f%% slow, %5.3fmA, "
+            "%5.1fmAh/day%s\n", build, awake_fast * 100, awake_slow * 100,
+            ma, mah, (limit && mah > limit) ? ", over the limit" : "");
+    return limit && mah > limit;
+}
+
+int main(int argc, char **argv)
+{
+    FILE *in = stdin;
+    char line[256];
+    char *p;
+    int failed = 0;
+
+    if (argc > 2) {
+        fprintf(stderr, "usage: energy [counters]\n");
+        return 2;
+    }
+    if (argc == 2 && !(in = fopen(argv[1], "r"))) {
+        perror(argv[1]);
+        return 2;
+    }
+    while (fgets(line, sizeof(line), in)) {
+        line[strcspn(line, "#\n")] = 0;
+        for (p = line; *p == ' ' || *p == '\t'; p++)
+            ;
+        if (*p)
+            failed |= estimate(p);
+    }
+    return failed;
+}
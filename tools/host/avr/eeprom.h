@@ -0,0 +1,44 @@
+// Title:    avr/eeprom.h for the host checks
+// File:     tools/host/avr/eeprom.h
+//
+// The EEPROM is host_eeprom, which the check defines and can look at.
+// Writes take no time.
+//
+
+#ifndef _AVR_EEPROM_H_
+#define _AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define E2END 0x1FF
+
+extern uint8_t host_eeprom[E2END + 1];
+
+static inline uint8_t eeprom_read_byte(const uint8_t *p)
+{
+    return host_eeprom[(uintptr_t)p];
+}
+
+static inline uint16_t eeprom_read_word(const uint16_t *p)
+{
+    return host_eeprom[(uintptr_t)p] | host_eeprom[(uintptr_t)p + 1] << 8;
+}
+
+static inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, host_eeprom + (uintptr_t)src, n);
+}
+
+static inline void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+    host_eeprom[(uintptr_t)p] = value;
+}
+
+static inline void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    memcpy(host_eeprom + (uintptr_t)dst, src, n);
+}
+
+#endif
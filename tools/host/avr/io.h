@@ -0,0 +1,31 @@
+// Title:    avr/io.h for the host checks
+// File:     tools/host/avr/io.h
+//
+// Just enough of avr-libc's avr/io.h to build the firmware modules the
+// checks in tools/ run on the PC.  The I/O registers are bytes of an
+// array that nothing reads back.
+//
+
+#ifndef _AVR_IO_H_
+#define _AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+static uint8_t host_io[0x60] __attribute__((unused));
+
+#define PINB  host_io[0x16]
+#define DDRB  host_io[0x17]
+#define PORTB host_io[0x18]
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#endif
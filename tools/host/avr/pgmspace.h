@@ -0,0 +1,21 @@
+// Title:    avr/pgmspace.h for the host checks
+// File:     tools/host/avr/pgmspace.h
+//
+// Flash and RAM are the same memory on the PC.
+//
+
+#ifndef __PGMSPACE_H_
+#define __PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+
+#endif
@@ -0,0 +1,15 @@
+// Title:    util/atomic.h for the host checks
+// File:     tools/host/util/atomic.h
+//
+// The checks have no interrupts, so an atomic block is just a block.
+//
+
+#ifndef _UTIL_ATOMIC_H_
+#define _UTIL_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) \
+    for (int host_atomic = 1; host_atomic; host_atomic = 0)
+
+#endif
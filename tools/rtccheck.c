@@ -0,0 +1,267 @@
+// Title:    RTC check
+// File:     tools/rtccheck.c
+//
+// Runs rtc.c on the PC against a model of the RTC's registers behind
+// the i2c.h calls: a DS3231, or a DS1307 when built with RTC_DS1307 set
+// to 1.  Checks that a time written reads back the same for every year
+// the chip keeps, that a stopped oscillator or a register out of range
+// makes reads fail until the time is set, that the DS3231's 32 kHz
+// output and the DS1307's NVRAM are left alone, and that rtc.c keeps to
+// the bus protocol: a register pointer before a read, no
+// acknowledge on the last byte and a stop after each transfer.
+//
+// Built and run with "make check".
+//
+
+#include <stdio.h>
+#include <string.h>
+#include "../i2c.h"
+#include "../rtc.h"
+
+#if RTC_DS1307
+#define CHIP          "DS1307"
+#define REGISTERS     0x40      // time, control and 56 bytes of NVRAM
+#define LAST_YEAR     2099
+#else
+#define CHIP          "DS3231"
+#define REGISTERS     0x13
+#define LAST_YEAR     2119
+#endif
+
+#define REG_SECONDS   0x00
+#define REG_MONTH     0x05
+#define REG_STATUS    0x0F
+#define STOPPED       0x80      // DS3231 OSF in status, DS1307 CH in seconds
+#define EN32KHZ       0x08      // DS3231 32 kHz output on, in status
+#define NVRAM_FILL    0xA5
+
+enum { IDLE, POINTER, WRITING, READING };
+
+static struct {
+    uint8_t reg[REGISTERS];
+    uint8_t present;
+    uint8_t state;
+    uint8_t pointer;
+    uint8_t acked;              // last byte read was acknowledged
+} rtc;
+
+static unsigned failures;
+static unsigned protocol_errors;
+
+static void fail(const char *what)
+{
+    if (failures++ < 10)
+        printf("rtccheck: %s: %s\n", CHIP, what);
+}
+
+static void protocol(const char *what)
+{
+    if (protocol_errors++ < 10)
+        printf("rtccheck: %s: bus: %s\n", CHIP, what);
+}
+
+// The chip as it powers up with no battery: oscillator stopped
+static void rtc_power_up(void)
+{
+    memset(rtc.reg, 0, sizeof(rtc.reg));
+#if RTC_DS1307
+    rtc.reg[REG_SECONDS] = STOPPED;
+    memset(rtc.reg + 0x08, NVRAM_FILL, REGISTERS - 0x08);
+#else
+    rtc.reg[REG_STATUS] = STOPPED | EN32KHZ;
+#endif
+    rtc.present = 1;
+    rtc.state = IDLE;
+}
+
+static uint8_t rtc_stopped(void)
+{
+#if RTC_DS1307
+    return rtc.reg[REG_SECONDS] & STOPPED;
+#else
+    return rtc.reg[REG_STATUS] & STOPPED;
+#endif
+}
+
+static void rtc_stop_oscillator(void)
+{
+#if RTC_DS1307
+    rtc.reg[REG_SECONDS] |= STOPPED;
+#else
+    rtc.reg[REG_STATUS] |= STOPPED;
+#endif
+}
+
+// the registers other than the time are as they powered up
+static uint8_t others_intact(void)
+{
+#if RTC_DS1307
+    uint8_t n;
+
+    for (n = 0x08; n < REGISTERS; n++)
+        if (rtc.reg[n] != NVRAM_FILL)
+            return 0;
+    return 1;
+#else
+    return (rtc.reg[REG_STATUS] & ~STOPPED) == EN32KHZ;
+#endif
+}
+
+// a register and a value out of its range, in BCD
+static const uint8_t out_of_range[][2] = {
+    { 0x00, 0x60 }, { 0x01, 0x60 }, { 0x02, 0x24 }, { 0x04, 0x00 },
+    { 0x04, 0x32 }, { 0x05, 0x00 }, { 0x05, 0x13 }, { 0x06, 0x19 },
+};
+#define OUT_OF_RANGE (sizeof(out_of_range) / sizeof(out_of_range[0]))
+
+void i2c_init(void)
+{
+}
+
+uint8_t i2c_start(uint8_t address, uint8_t direction)
+{
+    if (rtc.state == READING && rtc.acked)
+        protocol("repeated start after an acknowledged read");
+    if (!rtc.present || address != RTC_ADDRESS) {
+        rtc.state = IDLE;
+        return 0;
+    }
+    rtc.state = direction == I2C_READ ? READING : POINTER;
+    rtc.acked = 0;
+    return 1;
+}
+
+void i2c_stop(void)
+{
+    if (rtc.state == READING && rtc.acked)
+        protocol("stop after an acknowledged read");
+    rtc.state = IDLE;
+}
+
+uint8_t i2c_write(uint8_t data)
+{
+    uint8_t n;
+
+    switch (rtc.state) {
+    case POINTER:
+        if (data >= REGISTERS)
+            protocol("register pointer past the last register");
+        rtc.pointer = data % REGISTERS;
+        rtc.state = WRITING;
+        return 1;
+    case WRITING:
+        n = rtc.pointer;
+#if RTC_DS1307
+        // the month register has no century bit
+        if (n == REG_MONTH)
+            data &= 0x1F;
+#else
+        // OSF can only be cleared
+        if (n == REG_STATUS)
+            data = (data & ~STOPPED) | (data & rtc.reg[n] & STOPPED);
+#endif
+        rtc.reg[n] = data;
+        rtc.pointer = (n + 1) % REGISTERS;
+        return 1;
+    default:
+        protocol("write without a write start");
+        return 0;
+    }
+}
+
+uint8_t i2c_read(uint8_t ack)
+{
+    uint8_t data;
+
+    if (rtc.state != READING) {
+        protocol("read without a read start");
+        return 0xFF;
+    }
+    data = rtc.reg[rtc.pointer];
+    rtc.pointer = (rtc.pointer + 1) % REGISTERS;
+    rtc.acked = ack;
+    return data;
+}
+
+static uint8_t same(const struct clock_time *a, const struct clock_time *b)
+{
+    return a->year == b->year && a->month == b->month &&
+        a->day == b->day && a->hour == b->hour &&
+        a->minute == b->minute && a->second == b->second;
+}
+
+int main(void)
+{
+    struct clock_time set, got;
+    unsigned times = 0;
+    unsigned n;
+
+    // a chip that has lost the time is not believed until it is set
+    rtc_power_up();
+    if (rtc_clock_source.read(&got))
+        fail("read the time with the oscillator stopped");
+
+    set.year = 2024;
+    set.month = 2;
+    set.day = 29;
+    set.hour = 13;
+    set.minute = 45;
+    set.second = 30;
+    if (!rtc_clock_source.write(&set))
+        fail("write failed");
+    if (rtc_stopped())
+        fail("oscillator still flagged stopped after a write");
+    if (!rtc_clock_source.read(&got) || !same(&set, &got))
+        fail("time read back differs");
+
+    rtc_stop_oscillator();
+    if (rtc_clock_source.read(&got))
+        fail("read the time after the oscillator stopped");
+
+    // a register the battery or the bus got wrong
+    for (n = 0; n < OUT_OF_RANGE; n++) {
+        if (!rtc_clock_source.write(&set))
+            fail("write failed");
+        rtc.reg[out_of_range[n][0]] = out_of_range[n][1];
+        if (rtc_clock_source.read(&got)) {
+            char what[64];
+
+            snprintf(what, sizeof(what), "read a time with register %u "
+                    "at %02x", out_of_range[n][0], out_of_range[n][1]);
+            fail(what);
+        }
+    }
+
+    // every year the chip keeps, and each field over its range
+    for (set.year = 2020; set.year <= LAST_YEAR; set.year++) {
+        for (set.month = 1; set.month <= 12; set.month++) {
+            set.day = 1 + (set.year + set.month * 3) % 31;
+            set.hour = (set.year * 7 + set.month) % 24;
+            set.minute = (set.year + set.month * 5) % 60;
+            set.second = (set.year * 3 + set.month) % 60;
+            if (!rtc_clock_source.write(&set) ||
+                    !rtc_clock_source.read(&got) || !same(&set, &got)) {
+                char what[64];
+
+                snprintf(what, sizeof(what), "%04u-%02u-%02u %02u:%02u:%02u"
+                        " read back differs", set.year, set.month,
+                        set.day, set.hour, set.minute, set.second);
+                fail(what);
+            }
+            times++;
+        }
+    }
+    if (!others_intact())
+        fail(RTC_DS1307 ? "NVRAM changed" : "32 kHz output changed");
+
+    // no chip on the bus
+    rtc.present = 0;
+    if (rtc_clock_source.read(&got))
+        fail("read a time with no RTC");
+    if (rtc_clock_source.write(&set))
+        fail("wrote a time with no RTC");
+
+    printf("rtccheck: %s: %u times, %u failures, %u bus errors\n", CHIP,
+            times, failures, protocol_errors);
+    return failures || protocol_errors;
+}
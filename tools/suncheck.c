@@ -0,0 +1,122 @@
+// Title:    Sunrise check
+// File:     tools/suncheck.c
+//
+// Runs sun.c on the PC for every day from 2020 to 2119 and compares its
+// sunrise, sunset and moon with the same equations worked out in
+// double precision.  sun.c only takes its place at compile time, so
+// "make check" builds this once for each of SUN_PLACES.  The times are
+// compared in UTC, tz_local() here being the identity.
+//
+// Limits: a minute on sunrise and sunset up to 65 degrees of latitude,
+// ten minutes above, where the sun crosses the horizon at a shallow
+// angle; a day the reference has the sun up or down all day may be
+// a day with a short night or day in sun.c, or the other way round,
+// when half of that is shorter than the same limit.  The moon's lit
+// part must be within 1% and its phase, which sun.c rounds down, within
+// 2/256 of a lunation.
+//
+
+#include <stdio.h>
+#include <math.h>
+#include "../sun.h"
+
+#define DAYS 36525          // 2020 to 2119
+#define SUN_EPOCH 7305      // days from 1 January 2000 to 2020
+
+uint32_t tz_local(struct tz_zone *zone, uint16_t year, uint32_t utc,
+        uint8_t *dst)
+{
+    *dst = 0;
+    return utc;
+}
+
+static double radians(double degrees)
+{
+    return degrees * M_PI / 180;
+}
+
+// distance between minutes of the day a and b
+static double apart(double a, double b)
+{
+    double d = fabs(a - b);
+
+    return d > 720 ? 1440 - d : d;
+}
+
+int main(void)
+{
+    double limit = fabs(SUN_LATITUDE) <= 65 ? 1 : 10;
+    double worst_time = 0, worst_edge = 0, worst_lit = 0, worst_phase = 0;
+    double j, m, c, l, t, sd, cw, w, rise, set, phase, lit, e;
+    unsigned edges = 0;
+    uint8_t polar;
+    long d;
+
+    for (d = 0; d < DAYS; d++) {
+        sun_start(d, 2020, NULL);
+        while (sun_step())
+            ;
+
+        j = d + SUN_EPOCH - SUN_LONGITUDE / 360.0;
+        m = fmod(357.5291 + 0.98560028 * j, 360);
+        c = 1.9148 * sin(radians(m)) + 0.0200 * sin(radians(2 * m)) +
+            0.0003 * sin(radians(3 * m));
+        l = fmod(m + c + 180 + 102.9372, 360);
+        t = 0.5 - SUN_LONGITUDE / 360.0 + 0.0053 * sin(radians(m)) -
+            0.0069 * sin(radians(2 * l));
+        sd = sin(radians(l)) * sin(radians(23.4397));
+        cw = (sin(radians(-0.833)) - sin(radians(SUN_LATITUDE)) * sd) /
+            (cos(radians(SUN_LATITUDE)) * cos(asin(sd)));
+        polar = sun_today.rise < 0;
+
+        if (cw >= 1 || cw <= -1) {
+            if (!polar) {
+                // a short day or night that should not be there
+                e = apart(sun_today.set, sun_today.rise) / 2;
+                edges++;
+                if (e > worst_edge)
+                    worst_edge = e;
+            } else if (sun_today.rise != (cw >= 1 ? SUN_ALWAYS_DOWN :
+                        SUN_ALWAYS_UP)) {
+                printf("suncheck: day %ld up and down the wrong way\n", d);
+                return 1;
+            }
+        } else {
+            w = acos(cw) / (2 * M_PI);
+            rise = fmod((t - w) * 1440 + 1440 * 4, 1440);
+            set = fmod((t + w) * 1440 + 1440 * 4, 1440);
+            if (polar) {
+                // missed a short day or night
+                e = cw > 0 ? w * 1440 : (0.5 - w) * 1440;
+                edges++;
+                if (e > worst_edge)
+                    worst_edge = e;
+            } else {
+                e = fmax(apart(sun_today.rise, rise),
+                        apart(sun_today.set, set));
+                if (e > worst_time)
+                    worst_time = e;
+            }
+        }
+
+        phase = fmod((d + SUN_EPOCH - 5.2597) / 29.530588853, 1);
+        if (phase < 0)
+            phase += 1;
+        lit = (1 - cos(2 * M_PI * phase)) * 50;
+        e = fabs(sun_today.moon_phase - phase * 256);
+        if (e > 128)
+            e = 256 - e;
+        if (e > worst_phase)
+            worst_phase = e;
+        e = fabs(sun_today.moon_lit - lit);
+        if (e > worst_lit)
+            worst_lit = e;
+    }
+
+    printf("suncheck: %6.2f %7.2f: rise and set %.2f min, %u edge days "
+            "%.2f min, lit %.2f%%, phase %.2f/256\n", SUN_LATITUDE,
+            SUN_LONGITUDE, worst_time, edges, worst_edge, worst_lit,
+            worst_phase);
+    return worst_time > limit || worst_edge > limit || worst_lit > 1 ||
+        worst_phase > 2;
+}
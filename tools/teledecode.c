@@ -0,0 +1,135 @@
+// Title:    Telemetry decoder
+// File:     tools/teledecode.c
+//
+// Prints the telemetry frames sent by the clock, see telemetry.h.
+// Reads a serial port, a pty or standard input:
+//
+//     teledecode /dev/ttyUSB0
+//     teledecode < capture.bin
+//
+// Built on the PC with "make tools".
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+#define BAUD B9600
+
+// struct telemetry, packed
+#define FRAME_SIZE 24
+#define FRAME_VERSION 1
+
+// CRC-8, polynomial 0x07, as _crc8_ccitt_update() in avr-libc
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    int i;
+
+    while (length--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+// Undo COBS in place.  Returns the decoded length, or -1 if a code
+// byte points past the end.
+static int cobs_decode(uint8_t *data, size_t length)
+{
+    size_t in = 0, out = 0;
+    uint8_t code, i;
+
+    while (in < length) {
+        code = data[in++];
+        if (code == 0 || in + code - 1 > length)
+            return -1;
+        for (i = 1; i < code; i++)
+            data[out++] = data[in++];
+        if (code != 0xFF && in < length)
+            data[out++] = 0;
+    }
+    return out;
+}
+
+static unsigned get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static unsigned long get32(const uint8_t *p)
+{
+    return get16(p) | (unsigned long)get16(p + 2) << 16;
+}
+
+static void print_frame(const uint8_t *f)
+{
+    unsigned long seconds = get32(f + 2);
+
+    printf("#%3u %lud %02lu:%02lu:%02lu sub %3u drift %+4d reset %02X "
+            "buttons %u/%u/%u isr %u/%u loops %u lcd %u/%u stack %u\n",
+            f[1], seconds / 86400, seconds / 3600 % 24, seconds / 60 % 60,
+            seconds % 60, f[6], (int8_t)f[7], f[8], f[9], f[10], f[11],
+            get16(f + 12), get16(f + 14), get16(f + 16), get16(f + 18),
+            get16(f + 20), get16(f + 22));
+}
+
+// Put a serial port in raw mode at the clock's speed.  Anything else,
+// a pipe or a file, is read as it is.
+static void setup_tty(int fd)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) < 0)
+        return;
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, BAUD);
+    cfsetospeed(&tio, BAUD);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(fd, TCSANOW, &tio);
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t frame[256];
+    size_t length = 0;
+    uint8_t c;
+    int fd = 0;
+    int n;
+
+    if (argc > 1) {
+        fd = open(argv[1], O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+    setup_tty(fd);
+
+    // the first frame is probably cut, it is dropped for its CRC
+    while (read(fd, &c, 1) == 1) {
+        if (c) {
+            if (length < sizeof(frame))
+                frame[length++] = c;
+            continue;
+        }
+        n = cobs_decode(frame, length);
+        if (n < 0)
+            printf("bad COBS, %zu bytes\n", length);
+        else if (n != FRAME_SIZE + 1)
+            printf("bad length %d\n", n);
+        else if (crc8(frame, FRAME_SIZE) != frame[FRAME_SIZE])
+            printf("bad CRC\n");
+        else if (frame[0] != FRAME_VERSION)
+            printf("version %u\n", frame[0]);
+        else
+            print_frame(frame);
+        fflush(stdout);
+        length = 0;
+    }
+    return 0;
+}
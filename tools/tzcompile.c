@@ -0,0 +1,203 @@
+// Title:    Time zone compiler
+// File:     tools/tzcompile.c
+//
+// Compiles a POSIX TZ string into the zone record of tz.h and writes it
+// as Intel hex for avrdude:
+//
+//     tzcompile [-z zone] "CET-1CEST,M3.5.0,M10.5.0/3" > tz.hex
+//     avrdude ... -U eeprom:w:tz.hex:i
+//
+// Zone 0, the default, is the zone the clock keeps; 1 to TZ_ZONES - 1
+// are for the world clock.  Some versions of avrdude fill the rest of
+// the EEPROM with 0xFF when writing a hex file, which loses the
+// checkpoints and alarms.
+//
+// Only what the clock can do is accepted: offsets in 15 minutes,
+// abbreviations of up to 4 letters, and daylight saving rules in the
+// Mm.w.d form, changing on the hour within the day.  Without rules the
+// US ones are assumed, as glibc does.
+//
+// Built on the PC with "make tools".
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "../eemap.h"
+#include "../tz.h"
+
+static const char *tz_string;
+
+static void fail(const char *what, const char *at)
+{
+    fprintf(stderr, "tzcompile: %s at \"%s\" in \"%s\"\n", what, at,
+            tz_string);
+    exit(1);
+}
+
+// CRC-8, polynomial 0x07, as _crc8_ccitt_update() in avr-libc
+static uint8_t crc8(const uint8_t *data, size_t length)
+{
+    uint8_t crc = 0;
+    int i;
+
+    while (length--) {
+        crc ^= *data++;
+        for (i = 0; i < 8; i++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+    return crc;
+}
+
+// an abbreviation, letters or <quoted>
+static const char *parse_name(const char *p, char *name)
+{
+    const char *start = p;
+    size_t length;
+
+    if (*p == '<') {
+        start = ++p;
+        while (*p && *p != '>')
+            p++;
+        if (!*p)
+            fail("no closing >", start - 1);
+        length = p++ - start;
+    } else {
+        while (isalpha((unsigned char)*p))
+            p++;
+        length = p - start;
+    }
+    if (length < 3)
+        fail("name too short", start);
+    if (length > 4)
+        fail("name longer than 4", start);
+    memcpy(name, start, length);
+    return p;
+}
+
+// [+-]hh[:mm[:ss]], returned in minutes
+static const char *parse_time(const char *p, int *minutes)
+{
+    const char *start = p;
+    int sign = 1, hours, mins = 0, secs = 0;
+
+    if (*p == '+' || *p == '-')
+        sign = (*p++ == '-') ? -1 : 1;
+    if (!isdigit((unsigned char)*p))
+        fail("expected a time", start);
+    hours = strtol(p, (char **)&p, 10);
+    if (*p == ':') {
+        mins = strtol(p + 1, (char **)&p, 10);
+        if (*p == ':')
+            secs = strtol(p + 1, (char **)&p, 10);
+    }
+    if (secs || mins > 59 || hours > 24)
+        fail("time out of range", start);
+    *minutes = sign * (hours * 60 + mins);
+    return p;
+}
+
+// Mm.w.d[/time]
+static const char *parse_rule(const char *p, uint8_t *t)
+{
+    const char *start = p;
+    int month, week, weekday, minutes = 120;
+
+    if (sscanf(p, "M%d.%d.%d", &month, &week, &weekday) != 3)
+        fail("only Mm.w.d rules are supported", start);
+    if (month < 1 || month > 12 || week < 1 || week > 5 || weekday < 0 ||
+            weekday > 6)
+        fail("rule out of range", start);
+    while (*p && *p != '/' && *p != ',')
+        p++;
+    if (*p == '/')
+        p = parse_time(p + 1, &minutes);
+    if (minutes % 60 || minutes < 0 || minutes > 23 * 60)
+        fail("change must be on an hour from 0 to 23", start);
+    t[0] = month << 4 | week;
+    t[1] = weekday << 5 | minutes / 60;
+    return p;
+}
+
+static void compile(const char *p, struct tz_rule *rule)
+{
+    int offset, dst_offset;
+
+    memset(rule, 0, sizeof(*rule));
+    p = parse_name(p, rule->name[0]);
+    p = parse_time(p, &offset);
+    // POSIX offsets are west of UTC
+    offset = -offset;
+    if (offset % 15)
+        fail("offset not in 15 minutes", p);
+    rule->offset = offset / 15;
+    if (!*p)
+        return;
+
+    p = parse_name(p, rule->name[1]);
+    dst_offset = offset + 60;
+    if (*p && *p != ',') {
+        p = parse_time(p, &dst_offset);
+        dst_offset = -dst_offset;
+    }
+    if ((dst_offset - offset) % 15 || dst_offset <= offset ||
+            dst_offset - offset > 120)
+        fail("daylight saving not 15 to 120 minutes ahead", p);
+    rule->delta = (dst_offset - offset) / 15;
+    if (!*p)
+        p = ",M3.2.0,M11.1.0";
+    if (*p++ != ',')
+        fail("expected ,", p - 1);
+    p = parse_rule(p, rule->start);
+    if (*p++ != ',')
+        fail("expected ,", p - 1);
+    p = parse_rule(p, rule->end);
+    if (*p)
+        fail("trailing characters", p);
+    // the changes stay within their day
+    if (TZ_HOUR(rule->start) * 60 + rule->delta * 15 > 23 * 60 + 59 ||
+            TZ_HOUR(rule->end) * 60 < rule->delta * 15)
+        fail("change crosses midnight", "");
+}
+
+static void hex_line(unsigned address, const uint8_t *data, int length)
+{
+    uint8_t sum = length + (address >> 8) + address;
+    int i;
+
+    printf(":%02X%04X00", length, address);
+    for (i = 0; i < length; i++) {
+        printf("%02X", data[i]);
+        sum += data[i];
+    }
+    printf("%02X\n", (uint8_t)-sum);
+}
+
+int main(int argc, char **argv)
+{
+    struct tz_rule rule;
+    int zone = 0;
+    int c;
+
+    while ((c = getopt(argc, argv, "z:")) != -1) {
+        if (c != 'z')
+            goto usage;
+        zone = atoi(optarg);
+    }
+    if (optind != argc - 1 || zone < 0 || zone >= TZ_ZONES)
+        goto usage;
+
+    tz_string = argv[optind];
+    compile(tz_string, &rule);
+    rule.crc = crc8((const uint8_t *)&rule, TZ_RECORD_SIZE - 1);
+    hex_line(EEMAP_TZ + zone * TZ_RECORD_SIZE, (const uint8_t *)&rule,
+            TZ_RECORD_SIZE);
+    printf(":00000001FF\n");
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: tzcompile [-z zone] TZ\n");
+    return 1;
+}
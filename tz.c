@@ -0,0 +1,126 @@
+// Title:    Time zone rules
+// File:     tz.c
+//
+
+#include <stddef.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include "eemap.h"
+#include "date.h"
+#include "tz.h"
+
+typedef char tz_record_size_check
+    [sizeof(struct tz_rule) == TZ_RECORD_SIZE ? 1 : -1];
+
+// EST5EDT,M3.2.0,M11.1.0, the rule the clock always had
+static const PROGMEM struct tz_rule tz_default = {
+    { "EST", "EDT" }, -5 * 4, 4, { 3 << 4 | 2, 0 << 5 | 2 },
+    { 11 << 4 | 1, 0 << 5 | 2 }, 0, 0
+};
+
+static uint8_t tz_crc(const struct tz_rule *rule)
+{
+    const uint8_t *p = (const uint8_t *)rule;
+    uint8_t n = offsetof(struct tz_rule, crc);
+    uint8_t crc = 0;
+
+    while (n--)
+        crc = _crc8_ccitt_update(crc, *p++);
+    return crc;
+}
+
+uint8_t tz_load(uint8_t n, struct tz_zone *zone)
+{
+    eeprom_read_block(&zone->rule,
+            (const void *)(EEMAP_TZ + n * TZ_RECORD_SIZE), TZ_RECORD_SIZE);
+    zone->year = 0;
+    // all zero has a good CRC too
+    if ((zone->rule.crc == tz_crc(&zone->rule)) && zone->rule.name[0][0])
+        return 1;
+    if (n == 0)
+        memcpy_P(&zone->rule, &tz_default, sizeof(zone->rule));
+    return 0;
+}
+
+// Minute stamp of a change in year.
+static uint32_t tz_change(const uint8_t *t, uint16_t year)
+{
+    uint8_t month = TZ_MONTH(t);
+    uint16_t first = date_days(year, month, 1);
+    uint8_t day;
+
+    day = 1 + (TZ_WEEKDAY(t) + 7 - date_weekday(first)) % 7 +
+        (TZ_WEEK(t) - 1) * 7;
+    while (day > days_in_month(year, month))
+        day -= 7;
+    return (first + day - 1) * 1440UL + TZ_HOUR(t) * 60;
+}
+
+// Work out the changes for year, unless they are known already.
+static void tz_year(struct tz_zone *zone, uint16_t year)
+{
+    if (zone->year == year)
+        return;
+    zone->year = year;
+    zone->start = tz_change(zone->rule.start, year);
+    zone->end = tz_change(zone->rule.end, year);
+}
+
+uint8_t tz_dst(struct tz_zone *zone, uint16_t year, uint32_t stamp,
+        uint8_t dst)
+{
+    if (!zone->rule.delta)
+        return 0;
+    tz_year(zone, year);
+    if ((stamp < zone->end) && (stamp >= zone->end - tz_shift(zone)))
+        return dst;
+    // the southern hemisphere has the end of one summer first
+    if (zone->start < zone->end)
+        return (stamp >= zone->start) && (stamp < zone->end);
+    return (stamp >= zone->start) || (stamp < zone->end);
+}
+
+uint32_t tz_next(struct tz_zone *zone, uint16_t year, uint32_t stamp,
+        uint8_t dst)
+{
+    if (!zone->rule.delta)
+        return TZ_NEVER;
+    tz_year(zone, year);
+    if ((dst ? zone->end : zone->start) <= stamp)
+        tz_year(zone, year + 1);
+    return dst ? zone->end : zone->start;
+}
+
+uint32_t tz_utc(const struct tz_zone *zone, uint32_t stamp, uint8_t dst)
+{
+    stamp -= zone->rule.offset * 15;
+    if (dst)
+        stamp -= tz_shift(zone);
+    return stamp;
+}
+
+uint32_t tz_local(struct tz_zone *zone, uint16_t year, uint32_t utc,
+        uint8_t *dst)
+{
+    uint32_t stamp = utc + zone->rule.offset * 15;
+
+    *dst = 0;
+    if (!zone->rule.delta)
+        return stamp;
+    // the zone may be in another year than the clock around New Year
+    if (stamp < date_days(year, 1, 1) * 1440UL)
+        year--;
+    else if ((year < 2119) && (stamp >= date_days(year + 1, 1, 1) * 1440UL))
+        year++;
+    tz_year(zone, year);
+    // stamp is standard time, the end is in daylight time
+    if (zone->start < zone->end)
+        *dst = (stamp >= zone->start) &&
+            (stamp + tz_shift(zone) < zone->end);
+    else
+        *dst = (stamp >= zone->start) ||
+            (stamp + tz_shift(zone) < zone->end);
+    return *dst ? stamp + tz_shift(zone) : stamp;
+}
@@ -0,0 +1,85 @@
+// Title:    Time zone rules
+// File:     tz.h
+//
+// A zone is a 16 byte record in EEPROM compiled from a POSIX TZ string
+// by tools/tzcompile.c, so that a clock for another region needs no new
+// firmware.  Daylight saving starts and ends on the w'th weekday d of
+// month m (week 5 is the last), at a whole hour of local time, the
+// "Mm.w.d/h" form of POSIX.  Start is in standard time, end in daylight
+// time, and both changes must stay within their day.
+//
+// Times are minute stamps of local wall time, see alarm.h.  The change
+// instants are worked out for one year at a time and kept with the
+// zone, so deciding whether one is due is a single compare.
+//
+// This header is shared with the PC tools, keep it free of AVR headers.
+//
+
+#ifndef TZ_H
+#define TZ_H
+
+#include <inttypes.h>
+
+// zone records in EEPROM, record 0 is the zone the clock keeps
+#define TZ_ZONES 4
+#define TZ_RECORD_SIZE 16
+
+// a transition: month << 4 | week, weekday << 5 | hour
+#define TZ_MONTH(t) ((t)[0] >> 4)
+#define TZ_WEEK(t) ((t)[0] & 0x0F)
+#define TZ_WEEKDAY(t) ((t)[1] >> 5)
+#define TZ_HOUR(t) ((t)[1] & 0x1F)
+
+// no change ahead
+#define TZ_NEVER 0xFFFFFFFFUL
+
+struct tz_rule {
+    char name[2][4];        // standard and daylight time, NUL padded
+    int8_t offset;          // standard time, 15 minutes east of UTC
+    int8_t delta;           // daylight saving, 15 minutes, 0 for none
+    uint8_t start[2];       // daylight saving starts, standard time
+    uint8_t end[2];         // and ends, daylight time
+    uint8_t spare;
+    uint8_t crc;            // CRC-8 CCITT of the bytes before it
+};
+
+struct tz_zone {
+    struct tz_rule rule;
+    uint16_t year;          // year of start and end, 0 for not known yet
+    uint32_t start;
+    uint32_t end;
+};
+
+// Read zone record n, or for record 0 the default EST5EDT,M3.2.0,M11.1.0
+// if the EEPROM holds no valid one.  Returns zero if the record was not
+// valid.
+uint8_t tz_load(uint8_t n, struct tz_zone *zone);
+
+// Non-zero if daylight saving is in effect at stamp in year.  In the
+// hour that is repeated when it ends, returns dst, which says which
+// time of the two it is.
+uint8_t tz_dst(struct tz_zone *zone, uint16_t year, uint32_t stamp,
+        uint8_t dst);
+
+// The next change after stamp in year, into daylight saving if dst is
+// zero or out of it if not.  TZ_NEVER if the zone has no daylight
+// saving.
+uint32_t tz_next(struct tz_zone *zone, uint16_t year, uint32_t stamp,
+        uint8_t dst);
+
+// UTC minute stamp of wall time stamp in the zone, dst as for tz_dst().
+uint32_t tz_utc(const struct tz_zone *zone, uint32_t stamp, uint8_t dst);
+
+// Wall time in the zone at UTC minute stamp utc, and in dst whether
+// that is daylight time.  year is a year within one of it, the year of
+// the local clock will do.
+uint32_t tz_local(struct tz_zone *zone, uint16_t year, uint32_t utc,
+        uint8_t *dst);
+
+// Minutes the clock moves when daylight saving starts or ends.
+static inline uint8_t tz_shift(const struct tz_zone *zone)
+{
+    return zone->rule.delta * 15;
+}
+
+#endif // TZ_H